@@ -0,0 +1,318 @@
+#pragma once
+
+#ifndef ASYNCBINDINGS_HPP
+#define ASYNCBINDINGS_HPP
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Log.hpp"
+#include "StringUtils.hpp"
+#include "ThreadPool.hpp"
+#include "WebviewBackend.hpp"
+
+namespace groklab {
+    // Declared outside AsyncBindings so it can be defaulted in its member function signatures.
+    struct AsyncBindingOptions {
+        // Calls of one binding running at the same time; further calls wait in that binding's queue.
+        size_t maxConcurrent{4};
+    };
+
+    // A binding call tagged by the page runtime: ["<token>", arg1, arg2, ...]. Tokens are plain ASCII generated by
+    // runtime.js, so the first quoted string is the token.
+    struct TaggedRequest {
+        std::string token;
+        // JSON array of the remaining arguments.
+        std::string arguments;
+
+        [[nodiscard]] static TaggedRequest parse(const std::string_view request) {
+            const size_t begin = request.find('"');
+            const size_t end = begin == std::string_view::npos ? begin : request.find('"', begin + 1);
+            if (end == std::string_view::npos) {
+                return {{}, "[]"};
+            }
+            TaggedRequest result{std::string(request.substr(begin + 1, end - begin - 1)), "[]"};
+            if (const size_t comma = request.find(',', end); comma != std::string_view::npos) {
+                result.arguments = "[" + std::string(request.substr(comma + 1));
+            }
+            return result;
+        }
+    };
+
+    // Runs webview bindings on a shared work-stealing pool instead of one detached thread per call.
+    //
+    // Pages call these bindings through window.fluid.invoke(name, args, { signal }), which tags every call with a
+    // token. Each binding has its own concurrency limit; calls beyond it wait in a per-binding queue. A call is
+    // cancelled through its stop_token when the page aborts it (AbortSignal), when the page is hidden or
+    // navigates away, or when cancelAll() is called, e.g. before FluidUI replaces the page. Results are collected
+    // from the workers and handed back on the UI thread in batches: one dispatch and one eval settle every call
+    // that completed since the previous batch.
+    class AsyncBindings {
+    public:
+        // Receives the JSON array of arguments (without the call token) and returns the JSON encoded result.
+        // Exceptions reject the page's promise with their message.
+        using Handler = std::function<std::string(const std::string &arguments, std::stop_token stop)>;
+
+        using Options = AsyncBindingOptions;
+
+        static constexpr auto kCancelBinding = "__fluid_cancel";
+
+    private:
+        enum class Status {
+            kResolved = 0,
+            kRejected = 1,
+            kCancelled = 2
+        };
+
+        struct Call {
+            std::string token;
+            std::string arguments;
+            std::stop_source stop;
+        };
+
+        struct Binding {
+            std::string name;
+            Handler handler;
+            Options options;
+            size_t running{0};
+            std::deque<std::shared_ptr<Call> > waiting;
+        };
+
+        struct Completion {
+            std::string token;
+            Status status;
+            std::string value;
+        };
+
+        // Completed calls waiting for the UI thread. Shared with dispatched flushes so that a flush still queued
+        // in the webview when the executor is destroyed finds nothing to do instead of a dangling pointer.
+        struct Outbox {
+            std::mutex mutex;
+            std::vector<Completion> completions;
+        };
+
+        WebviewBackend &webview_;
+        std::mutex mutex_;
+        std::unordered_map<std::string, std::shared_ptr<Binding> > bindings_;
+        std::unordered_map<std::string, std::shared_ptr<Call> > calls_;
+        std::shared_ptr<Outbox> outbox_{std::make_shared<Outbox>()};
+        // Declared last: destroyed first, so every worker has finished before the state above goes away.
+        ThreadPool pool_;
+
+    public:
+        explicit AsyncBindings(WebviewBackend &webview,
+                               const size_t threadCount = std::max(1u, std::thread::hardware_concurrency()))
+            : webview_(webview), pool_(threadCount) {
+            webview_.bind(kCancelBinding, [this](const std::string &request) -> std::string {
+                const std::string token = TaggedRequest::parse(request).token;
+                if (token == "*") {
+                    cancelAll();
+                } else {
+                    cancel(token);
+                }
+                return "null";
+            });
+        }
+
+        AsyncBindings(const AsyncBindings &) = delete;
+        AsyncBindings &operator=(const AsyncBindings &) = delete;
+
+        ~AsyncBindings() {
+            cancelAll();
+            std::lock_guard lock(mutex_);
+            for (const auto &[name, binding]: bindings_) {
+                webview_.unbind(name);
+            }
+            webview_.unbind(kCancelBinding);
+        }
+
+        void bind(const std::string &name, Handler handler, const Options options = {}) {
+            {
+                std::lock_guard lock(mutex_);
+                auto binding = std::make_shared<Binding>();
+                binding->name = name;
+                binding->handler = std::move(handler);
+                binding->options = options;
+                binding->options.maxConcurrent = std::max<size_t>(1, options.maxConcurrent);
+                // Calls still running keep the binding they started on alive; queued calls move over and run
+                // with the new handler.
+                std::shared_ptr<Binding> &slot = bindings_[name];
+                if (slot) {
+                    binding->waiting = std::move(slot->waiting);
+                    slot->waiting.clear();
+                }
+                slot = binding;
+                while (binding->running < binding->options.maxConcurrent && !binding->waiting.empty()) {
+                    std::shared_ptr<Call> next = std::move(binding->waiting.front());
+                    binding->waiting.pop_front();
+                    start(binding, std::move(next));
+                }
+            }
+            // The webview promise only acknowledges the request; the result arrives through fluid.settle().
+            webview_.bind(name, [this, name](const std::string &request) -> std::string {
+                enqueue(name, request);
+                return "null";
+            });
+        }
+
+        // Requests cancellation of one call. Queued calls are settled as cancelled right away; running calls see
+        // their stop_token triggered and settle as cancelled when their handler returns.
+        void cancel(const std::string &token) {
+            std::lock_guard lock(mutex_);
+            const auto it = calls_.find(token);
+            if (it == calls_.end()) {
+                return;
+            }
+            it->second->stop.request_stop();
+            dropWaiting(it->second);
+        }
+
+        void cancelAll() {
+            std::lock_guard lock(mutex_);
+            for (const auto &[token, call]: calls_) {
+                call->stop.request_stop();
+            }
+            for (const auto &[name, binding]: bindings_) {
+                while (!binding->waiting.empty()) {
+                    dropWaiting(binding->waiting.front());
+                }
+            }
+        }
+
+        [[nodiscard]] size_t getPendingCount() {
+            std::lock_guard lock(mutex_);
+            return calls_.size();
+        }
+
+    private:
+        void enqueue(const std::string &name, const std::string &request) {
+            auto call = std::make_shared<Call>();
+            TaggedRequest tagged = TaggedRequest::parse(request);
+            call->token = std::move(tagged.token);
+            call->arguments = std::move(tagged.arguments);
+            if (call->token.empty()) {
+                error("Binding '{}' called without call token; use window.fluid.invoke()", name);
+                return;
+            }
+
+            std::lock_guard lock(mutex_);
+            const auto it = bindings_.find(name);
+            if (it == bindings_.end()) {
+                complete({call->token, Status::kRejected, "Unknown binding " + name});
+                return;
+            }
+            calls_[call->token] = call;
+            const std::shared_ptr<Binding> &binding = it->second;
+            if (binding->running < binding->options.maxConcurrent) {
+                start(binding, std::move(call));
+            } else {
+                binding->waiting.push_back(std::move(call));
+            }
+        }
+
+        // Called with mutex_ held. The task holds its own reference to the binding, which bind() may replace.
+        void start(const std::shared_ptr<Binding> &binding, std::shared_ptr<Call> call) {
+            ++binding->running;
+            pool_.submit([this, binding, call = std::move(call)] {
+                Completion completion{call->token, Status::kResolved, {}};
+                try {
+                    completion.value = binding->handler(call->arguments, call->stop.get_token());
+                } catch (const std::exception &e) {
+                    completion = {call->token, Status::kRejected, e.what()};
+                } catch (...) {
+                    completion = {call->token, Status::kRejected, "Unknown error"};
+                }
+                if (call->stop.stop_requested()) {
+                    completion = {call->token, Status::kCancelled, {}};
+                }
+
+                std::lock_guard lock(mutex_);
+                eraseCall(call);
+                --binding->running;
+                if (!binding->waiting.empty()) {
+                    std::shared_ptr<Call> next = std::move(binding->waiting.front());
+                    binding->waiting.pop_front();
+                    start(binding, std::move(next));
+                }
+                complete(std::move(completion));
+            });
+        }
+
+        // Called with mutex_ held. Takes the call by value since erasing it may drop the last other reference.
+        void dropWaiting(const std::shared_ptr<Call> call) {
+            for (const auto &[name, binding]: bindings_) {
+                const auto it = std::find(binding->waiting.begin(), binding->waiting.end(), call);
+                if (it != binding->waiting.end()) {
+                    binding->waiting.erase(it);
+                    eraseCall(call);
+                    complete({call->token, Status::kCancelled, {}});
+                    return;
+                }
+            }
+        }
+
+        // Called with mutex_ held. Erases the token only while it still names this call.
+        void eraseCall(const std::shared_ptr<Call> &call) {
+            if (const auto it = calls_.find(call->token); it != calls_.end() && it->second == call) {
+                calls_.erase(it);
+            }
+        }
+
+        // Queues a completion; the first one of a batch schedules the flush on the UI thread.
+        void complete(Completion &&completion) {
+            bool schedule;
+            {
+                std::lock_guard lock(outbox_->mutex);
+                schedule = outbox_->completions.empty();
+                outbox_->completions.push_back(std::move(completion));
+            }
+            if (schedule) {
+                webview_.dispatch([outbox = std::weak_ptr(outbox_), webview = &webview_] {
+                    if (const auto locked = outbox.lock()) {
+                        flush(*locked, *webview);
+                    }
+                });
+            }
+        }
+
+        static void flush(Outbox &outbox, WebviewBackend &webview) {
+            std::vector<Completion> completions;
+            {
+                std::lock_guard lock(outbox.mutex);
+                completions.swap(outbox.completions);
+            }
+            if (completions.empty()) {
+                return;
+            }
+            std::string script = "window.fluid && window.fluid.settle([";
+            for (size_t i = 0; i < completions.size(); ++i) {
+                const Completion &completion = completions[i];
+                if (i > 0) {
+                    script.push_back(',');
+                }
+                script.push_back('[');
+                StringUtils::appendJsonString(script, completion.token);
+                script.append(",").append(std::to_string(static_cast<int>(completion.status))).append(",");
+                if (completion.status == Status::kResolved) {
+                    script.append(completion.value.empty() ? "null" : completion.value);
+                } else {
+                    StringUtils::appendJsonString(script, completion.value);
+                }
+                script.push_back(']');
+            }
+            script.append("]);");
+            webview.eval(script);
+        }
+    };
+}
+
+#endif //ASYNCBINDINGS_HPP
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef BENCHMARKUTILS_HPP
+#define BENCHMARKUTILS_HPP
+
+#include <chrono>
+#include <string>
+#include "Log.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace groklab {
+    struct BenchmarkUtils {
+        using Clock = std::chrono::steady_clock;
+
+        struct Result {
+            std::string name;
+            size_t iterations{0};
+            double totalMs{0.0};
+            double perIterationUs{0.0};
+        };
+
+        // Runs func once to warm caches, then times `iterations` back to back calls and logs the result.
+        template<typename Func>
+        static Result run(const std::string &name, const size_t iterations, Func &&func) {
+            func();
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                func();
+            }
+            const double totalMs = elapsedMs(start);
+            Result result{name, iterations, totalMs, iterations == 0 ? 0.0 : totalMs * 1000.0 / iterations};
+            info("[bench] {}: {} iterations in {:.3f} ms ({:.3f} us/iter)", result.name, result.iterations,
+                 result.totalMs, result.perIterationUs);
+            return result;
+        }
+
+        static double elapsedMs(const Clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        // Keeps the optimizer from discarding a computed value: the compiler must assume the barrier reads it.
+        template<typename T>
+        static void doNotOptimize(const T &value) {
+#ifdef _MSC_VER
+            // No inline asm on MSVC; a volatile store of the address is an observable side effect instead.
+            static const void *volatile sink = nullptr;
+            sink = &value;
+            _ReadWriteBarrier();
+#else
+            asm volatile("" : : "g"(&value) : "memory");
+#endif
+        }
+    };
+}
+
+#endif //BENCHMARKUTILS_HPP
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef BRIDGEENCODING_HPP
+#define BRIDGEENCODING_HPP
+
+#include <string>
+#include <string_view>
+#include <rfl.hpp>
+#include <rfl/json.hpp>
+#ifdef FLUID_CBOR_BRIDGE
+#include <rfl/cbor.hpp>
+#endif
+#include "Log.hpp"
+#include "StringUtils.hpp"
+
+namespace groklab {
+    // How a payload crosses the bridge. JSON is written as text and parsed again by the page. CBOR is smaller and
+    // cheaper to produce for numeric-heavy data such as chart series or grid pages; it travels as a base64 string
+    // and window.fluid.decodeCbor() turns it back into the same JS value the JSON would have produced.
+    // CBOR needs reflect-cpp's CBOR support (CMake option FLUID_CBOR_BRIDGE); without it payloads fall back to JSON.
+    enum class BridgeEncoding {
+        kJson,
+        kCbor
+    };
+
+    struct BridgeCodec {
+        [[nodiscard]] static constexpr bool isCborAvailable() {
+#ifdef FLUID_CBOR_BRIDGE
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        // Encoding actually used for a request, after the fallback described above.
+        [[nodiscard]] static BridgeEncoding effective(const BridgeEncoding encoding) {
+            if (encoding == BridgeEncoding::kCbor && !isCborAvailable()) {
+                static const bool warned = [] {
+                    warn("CBOR bridge encoding requested but FLUID_CBOR_BRIDGE is off; sending JSON instead");
+                    return true;
+                }();
+                (void) warned;
+                return BridgeEncoding::kJson;
+            }
+            return encoding;
+        }
+
+        // JSON text for kJson; for kCbor a JSON string literal holding the base64 encoded CBOR. Suitable for
+        // webview::resolve, where the page decodes the string itself.
+        template<typename T>
+        [[nodiscard]] static std::string toJson(const T &value, const BridgeEncoding encoding) {
+#ifdef FLUID_CBOR_BRIDGE
+            if (effective(encoding) == BridgeEncoding::kCbor) {
+                std::string result;
+                appendCborString(result, value);
+                return result;
+            }
+#endif
+            (void) effective(encoding);
+            return rfl::json::write(value);
+        }
+
+        // JS expression evaluating to the value, e.g. a BridgeQueue payload. CBOR payloads decode on arrival.
+        template<typename T>
+        [[nodiscard]] static std::string toScript(const T &value, const BridgeEncoding encoding) {
+#ifdef FLUID_CBOR_BRIDGE
+            if (effective(encoding) == BridgeEncoding::kCbor) {
+                std::string result = "window.fluid.decodeCbor(";
+                appendCborString(result, value);
+                result.push_back(')');
+                return result;
+            }
+#endif
+            (void) effective(encoding);
+            return rfl::json::write(value);
+        }
+
+    private:
+#ifdef FLUID_CBOR_BRIDGE
+        template<typename T>
+        static void appendCborString(std::string &out, const T &value) {
+            const auto bytes = rfl::cbor::write(value);
+            out.reserve(out.size() + (bytes.size() + 2) / 3 * 4 + 2);
+            out.push_back('"');
+            StringUtils::appendBase64(out, std::string_view(bytes.data(), bytes.size()));
+            out.push_back('"');
+        }
+#endif
+    };
+}
+
+#endif //BRIDGEENCODING_HPP
@@ -0,0 +1,174 @@
+#pragma once
+
+#ifndef BRIDGEQUEUE_HPP
+#define BRIDGEQUEUE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "StringUtils.hpp"
+
+namespace groklab {
+    // Outbound C++ to page message queue. Any thread may post; the UI thread drains the queue once per frame
+    // into a single script, so a burst of updates costs one eval instead of one eval per update.
+    //
+    // Messages addressed to the same channel and key are merged: a later payload replaces the pending one but
+    // keeps its place in the batch, so the page only ever sees the latest value. Messages posted without a key
+    // are delivered one by one, in order.
+    class BridgeQueue {
+    public:
+        struct Metrics {
+            size_t queueDepth{0};
+            size_t postedCount{0};
+            size_t mergedCount{0};
+            size_t flushCount{0};
+            size_t flushedCount{0};
+            size_t lastFlushSize{0};
+            size_t maxFlushSize{0};
+            // Time from the first message of a batch being posted until the batch is flushed.
+            double lastFlushLatencyMs{0.0};
+            double maxFlushLatencyMs{0.0};
+            // Time between consecutive flushes, i.e. the frame cadence the page actually sees.
+            double lastFlushIntervalMs{0.0};
+            double minFlushIntervalMs{0.0};
+            double totalFlushIntervalMs{0.0};
+
+            [[nodiscard]] double averageFlushSize() const {
+                return flushCount == 0 ? 0.0 : static_cast<double>(flushedCount) / static_cast<double>(flushCount);
+            }
+
+            [[nodiscard]] double averageFlushIntervalMs() const {
+                return flushCount < 2 ? 0.0 : totalFlushIntervalMs / static_cast<double>(flushCount - 1);
+            }
+        };
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Message {
+            std::string channel;
+            std::string key;
+            std::string payload;
+        };
+
+        mutable std::mutex mutex_;
+        std::vector<Message> messages_;
+        // channel '\x1f' key -> position in messages_ of the pending keyed message.
+        std::unordered_map<std::string, size_t> pending_;
+        std::string lookupKey_;
+        Clock::time_point batchStart_{};
+        Clock::time_point lastFlush_{};
+        Metrics metrics_;
+
+    public:
+        // Queues a payload for channel/key, replacing a pending payload for the same pair. The payload is JSON or
+        // any other JS expression, such as BridgeCodec::toScript() output. Returns true if the queue was empty
+        // before, i.e. when the caller should schedule a flush.
+        bool post(const std::string_view channel, const std::string_view key, std::string payload) {
+            std::lock_guard lock(mutex_);
+            ++metrics_.postedCount;
+            lookupKey_.assign(channel).push_back('\x1f');
+            lookupKey_.append(key);
+            if (const auto it = pending_.find(lookupKey_); it != pending_.end()) {
+                messages_[it->second].payload = std::move(payload);
+                ++metrics_.mergedCount;
+                return false;
+            }
+            pending_.emplace(lookupKey_, messages_.size());
+            return push({std::string(channel), std::string(key), std::move(payload)});
+        }
+
+        // Queues a payload that is never merged with other messages.
+        bool postEvent(const std::string_view channel, std::string payload) {
+            std::lock_guard lock(mutex_);
+            ++metrics_.postedCount;
+            return push({std::string(channel), {}, std::move(payload)});
+        }
+
+        [[nodiscard]] bool empty() const {
+            std::lock_guard lock(mutex_);
+            return messages_.empty();
+        }
+
+        [[nodiscard]] size_t size() const {
+            std::lock_guard lock(mutex_);
+            return messages_.size();
+        }
+
+        [[nodiscard]] Metrics getMetrics() const {
+            std::lock_guard lock(mutex_);
+            Metrics metrics = metrics_;
+            metrics.queueDepth = messages_.size();
+            return metrics;
+        }
+
+        // Drains the queue into `window.fluid.receive([[channel, key, payload], ...])`. Returns an empty string
+        // when nothing is queued. The queue lock is only held to swap the batch out, not while formatting it.
+        [[nodiscard]] std::string takeScript() {
+            std::vector<Message> batch;
+            {
+                std::lock_guard lock(mutex_);
+                if (messages_.empty()) {
+                    return {};
+                }
+                batch.swap(messages_);
+                pending_.clear();
+                const Clock::time_point now = Clock::now();
+                const double latencyMs = std::chrono::duration<double, std::milli>(now - batchStart_).count();
+                if (metrics_.flushCount > 0) {
+                    const double intervalMs = std::chrono::duration<double, std::milli>(now - lastFlush_).count();
+                    metrics_.minFlushIntervalMs = metrics_.flushCount == 1
+                                                      ? intervalMs
+                                                      : std::min(metrics_.minFlushIntervalMs, intervalMs);
+                    metrics_.lastFlushIntervalMs = intervalMs;
+                    metrics_.totalFlushIntervalMs += intervalMs;
+                }
+                lastFlush_ = now;
+                ++metrics_.flushCount;
+                metrics_.flushedCount += batch.size();
+                metrics_.lastFlushSize = batch.size();
+                metrics_.maxFlushSize = std::max(metrics_.maxFlushSize, batch.size());
+                metrics_.lastFlushLatencyMs = latencyMs;
+                metrics_.maxFlushLatencyMs = std::max(metrics_.maxFlushLatencyMs, latencyMs);
+            }
+
+            size_t bytes = 64;
+            for (const auto &message: batch) {
+                bytes += message.channel.size() + message.key.size() + message.payload.size() + 16;
+            }
+            std::string script;
+            script.reserve(bytes);
+            script.append("window.fluid && window.fluid.receive([");
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (i > 0) {
+                    script.push_back(',');
+                }
+                script.push_back('[');
+                StringUtils::appendJsonString(script, batch[i].channel);
+                script.push_back(',');
+                StringUtils::appendJsonString(script, batch[i].key);
+                script.push_back(',');
+                script.append(batch[i].payload.empty() ? "null" : batch[i].payload);
+                script.push_back(']');
+            }
+            script.append("]);");
+            return script;
+        }
+
+    private:
+        bool push(Message &&message) {
+            const bool wasEmpty = messages_.empty();
+            if (wasEmpty) {
+                batchStart_ = Clock::now();
+            }
+            messages_.push_back(std::move(message));
+            return wasEmpty;
+        }
+    };
+}
+
+#endif //BRIDGEQUEUE_HPP
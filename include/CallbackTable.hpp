@@ -0,0 +1,317 @@
+#pragma once
+
+#ifndef CALLBACKTABLE_HPP
+#define CALLBACKTABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include <rfl.hpp>
+#include <rfl/json.hpp>
+
+#include "Log.hpp"
+#include "StringUtils.hpp"
+
+namespace groklab {
+    // Signature of a callable: plain functions, function pointers, lambdas and other function objects.
+    template<typename F>
+    struct CallableTraits : CallableTraits<decltype(&std::remove_cvref_t<F>::operator())> {
+    };
+
+    template<typename R, typename... Args>
+    struct CallableTraits<R(Args...)> {
+        using Result = R;
+        using Arguments = std::tuple<std::decay_t<Args>...>;
+    };
+
+    template<typename R, typename... Args>
+    struct CallableTraits<R(Args...) noexcept> : CallableTraits<R(Args...)> {
+    };
+
+    template<typename R, typename... Args>
+    struct CallableTraits<R(*)(Args...)> : CallableTraits<R(Args...)> {
+    };
+
+    template<typename R, typename... Args>
+    struct CallableTraits<R(*)(Args...) noexcept> : CallableTraits<R(Args...)> {
+    };
+
+    // operator() of a function object, with any const, ref and noexcept qualifiers.
+#define GROKLAB_CALLABLE_MEMBER_TRAITS(QUALIFIERS)                                                               \
+    template<typename C, typename R, typename... Args>                                                          \
+    struct CallableTraits<R(C::*)(Args...) QUALIFIERS> : CallableTraits<R(Args...)> {                           \
+    };                                                                                                          \
+    template<typename C, typename R, typename... Args>                                                          \
+    struct CallableTraits<R(C::*)(Args...) QUALIFIERS noexcept> : CallableTraits<R(Args...)> {                  \
+    };
+
+    GROKLAB_CALLABLE_MEMBER_TRAITS()
+    GROKLAB_CALLABLE_MEMBER_TRAITS(const)
+    GROKLAB_CALLABLE_MEMBER_TRAITS(&)
+    GROKLAB_CALLABLE_MEMBER_TRAITS(const &)
+    GROKLAB_CALLABLE_MEMBER_TRAITS(&&)
+    GROKLAB_CALLABLE_MEMBER_TRAITS(const &&)
+#undef GROKLAB_CALLABLE_MEMBER_TRAITS
+
+    // Type erased callable with inline storage. Unlike std::function it never allocates, and besides a typed
+    // entry point it can decode its arguments from a JSON array payload as sent by the webview bridge.
+    class InplaceCallback {
+    public:
+        static constexpr size_t kCapacity = 48;
+
+    private:
+        using JsonInvoker = std::optional<std::string>(*)(void *, std::string_view);
+        using TypedInvoker = void(*)(void *, void *);
+        using Destroyer = void(*)(void *);
+        using Mover = void(*)(void *, void *);
+
+        alignas(std::max_align_t) std::byte storage_[kCapacity]{};
+        JsonInvoker invokeJson_{nullptr};
+        TypedInvoker invokeTyped_{nullptr};
+        Destroyer destroy_{nullptr};
+        Mover move_{nullptr};
+        const std::type_info *signature_{nullptr};
+
+    public:
+        InplaceCallback() = default;
+
+        template<typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, InplaceCallback> > >
+        explicit InplaceCallback(Func &&func) {
+            using Callable = std::decay_t<Func>;
+            using Traits = CallableTraits<Callable>;
+            using Arguments = typename Traits::Arguments;
+            using Result = typename Traits::Result;
+            static_assert(sizeof(Callable) <= kCapacity, "Callback captures too much state for inline storage");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t), "Callback is over-aligned");
+            static_assert(std::is_nothrow_move_constructible_v<Callable>, "Callback must be nothrow movable");
+
+            ::new(static_cast<void *>(storage_)) Callable(std::forward<Func>(func));
+            signature_ = &typeid(Arguments);
+            destroy_ = [](void *storage) {
+                std::launder(static_cast<Callable *>(storage))->~Callable();
+            };
+            move_ = [](void *from, void *to) {
+                ::new(to) Callable(std::move(*std::launder(static_cast<Callable *>(from))));
+            };
+            invokeTyped_ = [](void *storage, void *arguments) {
+                std::apply(*std::launder(static_cast<Callable *>(storage)), std::move(*static_cast<Arguments *>(arguments)));
+            };
+            invokeJson_ = [](void *storage, const std::string_view payload) -> std::optional<std::string> {
+                Arguments arguments{};
+                if constexpr (std::tuple_size_v<Arguments> > 0) {
+                    auto decoded = rfl::json::read<Arguments>(payload);
+                    if (!decoded) {
+                        error("Failed to decode callback arguments from {}", payload);
+                        return std::nullopt;
+                    }
+                    arguments = std::move(decoded.value());
+                }
+                auto &callable = *std::launder(static_cast<Callable *>(storage));
+                if constexpr (std::is_void_v<Result>) {
+                    std::apply(callable, std::move(arguments));
+                    return std::string{"null"};
+                } else {
+                    return rfl::json::write(std::apply(callable, std::move(arguments)));
+                }
+            };
+        }
+
+        InplaceCallback(InplaceCallback &&other) noexcept {
+            moveFrom(other);
+        }
+
+        InplaceCallback &operator=(InplaceCallback &&other) noexcept {
+            if (this != &other) {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        InplaceCallback(const InplaceCallback &) = delete;
+        InplaceCallback &operator=(const InplaceCallback &) = delete;
+
+        ~InplaceCallback() {
+            reset();
+        }
+
+        [[nodiscard]] explicit operator bool() const {
+            return destroy_ != nullptr;
+        }
+
+        template<typename... Args>
+        [[nodiscard]] bool accepts() const {
+            return signature_ != nullptr && *signature_ == typeid(std::tuple<std::decay_t<Args>...>);
+        }
+
+        // Calls with already typed arguments; returns false if they do not match the registered signature.
+        template<typename... Args>
+        bool call(Args &&... args) {
+            if (!accepts<Args...>()) {
+                return false;
+            }
+            std::tuple<std::decay_t<Args>...> arguments{std::forward<Args>(args)...};
+            invokeTyped_(storage_, &arguments);
+            return true;
+        }
+
+        // Decodes a JSON array of arguments, calls, and returns the JSON encoded result ("null" for void).
+        std::optional<std::string> callJson(const std::string_view payload) {
+            return invokeJson_(storage_, payload);
+        }
+
+    private:
+        void moveFrom(InplaceCallback &other) {
+            if (other.destroy_ == nullptr) {
+                return;
+            }
+            other.move_(other.storage_, storage_);
+            invokeJson_ = other.invokeJson_;
+            invokeTyped_ = other.invokeTyped_;
+            destroy_ = other.destroy_;
+            move_ = other.move_;
+            signature_ = other.signature_;
+            other.reset();
+        }
+
+        void reset() {
+            if (destroy_ != nullptr) {
+                destroy_(storage_);
+            }
+            invokeJson_ = nullptr;
+            invokeTyped_ = nullptr;
+            destroy_ = nullptr;
+            move_ = nullptr;
+            signature_ = nullptr;
+        }
+    };
+
+    // Name to callback table. Callbacks are registered up front; freeze() then builds a perfect hash over the
+    // names so every lookup is one hash, one slot probe and one string compare.
+    class CallbackTable {
+        struct Entry {
+            std::string name;
+            InplaceCallback callback;
+        };
+
+        std::vector<Entry> entries_;
+        std::vector<uint32_t> slots_;
+        uint64_t seed_{0};
+        uint64_t mask_{0};
+        bool frozen_{false};
+
+        static constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+    public:
+        template<typename Func>
+        void add(const std::string &name, Func &&func) {
+            if (Entry *entry = find(name)) {
+                entry->callback = InplaceCallback(std::forward<Func>(func));
+                return;
+            }
+            entries_.push_back({name, InplaceCallback(std::forward<Func>(func))});
+            frozen_ = false;
+        }
+
+        // Builds the perfect hash. Adding callbacks afterwards is allowed but falls back to linear lookup
+        // until freeze() is called again.
+        void freeze() {
+            size_t tableSize = 1;
+            while (tableSize < entries_.size() * 2) {
+                tableSize <<= 1;
+            }
+            mask_ = tableSize - 1;
+            for (uint64_t seed = 1;; ++seed) {
+                slots_.assign(tableSize, kEmptySlot);
+                bool collision = false;
+                for (uint32_t i = 0; i < entries_.size() && !collision; ++i) {
+                    uint32_t &slot = slots_[slotOf(entries_[i].name, seed)];
+                    collision = slot != kEmptySlot;
+                    slot = i;
+                }
+                if (!collision) {
+                    seed_ = seed;
+                    break;
+                }
+                // A table twice the key count usually resolves within a few seeds; grow if it does not.
+                if (seed % 64 == 0) {
+                    tableSize <<= 1;
+                    mask_ = tableSize - 1;
+                }
+            }
+            frozen_ = true;
+        }
+
+        [[nodiscard]] bool isFrozen() const {
+            return frozen_;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return entries_.size();
+        }
+
+        [[nodiscard]] bool contains(const std::string_view name) const {
+            return find(name) != nullptr;
+        }
+
+        template<typename... Args>
+        bool call(const std::string_view name, Args &&... args) {
+            Entry *entry = find(name);
+            if (entry == nullptr) {
+                error("Function '{}' not found", name);
+                return false;
+            }
+            if (!entry->callback.call(std::forward<Args>(args)...)) {
+                error("Function '{}' called with mismatching arguments", name);
+                return false;
+            }
+            return true;
+        }
+
+        std::optional<std::string> callJson(const std::string_view name, const std::string_view payload) {
+            Entry *entry = find(name);
+            if (entry == nullptr) {
+                error("Function '{}' not found", name);
+                return std::nullopt;
+            }
+            return entry->callback.callJson(payload);
+        }
+
+    private:
+        [[nodiscard]] uint64_t slotOf(const std::string_view name, const uint64_t seed) const {
+            uint64_t h = StringUtils::hash(name, 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull));
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            return h & mask_;
+        }
+
+        [[nodiscard]] Entry *find(const std::string_view name) {
+            return const_cast<Entry *>(std::as_const(*this).find(name));
+        }
+
+        [[nodiscard]] const Entry *find(const std::string_view name) const {
+            if (frozen_) {
+                const uint32_t index = slots_[slotOf(name, seed_)];
+                return index != kEmptySlot && entries_[index].name == name ? &entries_[index] : nullptr;
+            }
+            for (const auto &entry: entries_) {
+                if (entry.name == name) {
+                    return &entry;
+                }
+            }
+            return nullptr;
+        }
+    };
+}
+
+#endif //CALLBACKTABLE_HPP
@@ -0,0 +1,308 @@
+#pragma once
+
+#ifndef COMPONENTCACHE_HPP
+#define COMPONENTCACHE_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ComponentDefinition.hpp"
+#include "FileUtils.hpp"
+#include "Log.hpp"
+#include "MappedFile.hpp"
+#include "StringUtils.hpp"
+
+namespace groklab {
+    // Persistent cache of parsed components. Each .vue file maps to one binary entry holding its sections,
+    // prop names and pre-serialized template; warm loads memory-map the entry and never touch the source or
+    // lexbor. An entry is reused while the source size and modification time match, and otherwise only if
+    // the FNV-1a hash of the source content is unchanged.
+    class ComponentCache {
+    public:
+        struct Stats {
+            size_t warmLoads{0};
+            size_t coldLoads{0};
+            double warmMs{0.0};
+            double coldMs{0.0};
+        };
+
+    private:
+        static constexpr std::array<char, 4> kMagic{'F', 'G', 'C', 'C'};
+        static constexpr uint32_t kVersion = 1;
+
+        enum Section : uint32_t {
+            kName,
+            kTemplate,
+            kCss,
+            kJavascript,
+            kSerializedTemplate,
+            kSectionCount
+        };
+
+        struct Header {
+            std::array<char, 4> magic{};
+            uint32_t version{0};
+            uint64_t sourceSize{0};
+            int64_t sourceTime{0};
+            uint64_t contentHash{0};
+            uint32_t sectionCount{0};
+            uint32_t propCount{0};
+        };
+
+        struct Span {
+            uint32_t offset{0};
+            uint32_t length{0};
+        };
+
+        struct SourceStamp {
+            uint64_t size{0};
+            int64_t time{0};
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        std::filesystem::path directory_;
+        mutable std::mutex statsMutex_;
+        Stats stats_{};
+
+    public:
+        explicit ComponentCache(std::filesystem::path directory) : directory_(std::move(directory)) {
+            std::error_code ec;
+            std::filesystem::create_directories(directory_, ec);
+            if (ec) {
+                error("Failed to create component cache directory {}: {}", directory_.string(), ec.message());
+            }
+        }
+
+        [[nodiscard]] const std::filesystem::path &getDirectory() const {
+            return directory_;
+        }
+
+        [[nodiscard]] std::shared_ptr<const ComponentDefinition> load(const std::filesystem::path &sourcePath) {
+            const auto start = Clock::now();
+            const std::filesystem::path entry = entryPath(sourcePath);
+            const SourceStamp stamp = stampOf(sourcePath);
+
+            std::shared_ptr<const MappedFile> mapping = mapEntry(entry);
+            std::optional<Header> header = mapping ? readHeader(*mapping) : std::nullopt;
+            if (header && header->sourceSize == stamp.size && header->sourceTime == stamp.time) {
+                if (auto definition = restore(mapping, *header)) {
+                    record(start, true);
+                    return definition;
+                }
+            }
+
+            std::string source = FileUtils::readFileAsString(sourcePath.string());
+            const uint64_t contentHash = StringUtils::hash(source);
+            if (header && header->contentHash == contentHash) {
+                if (auto definition = restore(mapping, *header)) {
+                    refreshStamp(entry, *mapping, *header, stamp);
+                    record(start, true);
+                    return definition;
+                }
+            }
+
+            auto definition = std::make_shared<const ComponentDefinition>(sourcePath.stem().string(),
+                                                                          std::move(source));
+            store(entry, *definition, stamp, contentHash);
+            record(start, false);
+            return definition;
+        }
+
+        [[nodiscard]] Stats getStats() const {
+            std::lock_guard lock(statsMutex_);
+            return stats_;
+        }
+
+        void logStats() const {
+            const Stats stats = getStats();
+            info("Component cache: {} warm loads in {:.3f} ms, {} cold loads in {:.3f} ms",
+                 stats.warmLoads, stats.warmMs, stats.coldLoads, stats.coldMs);
+        }
+
+        void clear() {
+            std::error_code ec;
+            for (const auto &entry: std::filesystem::directory_iterator(directory_, ec)) {
+                if (entry.path().extension() == ".fgc") {
+                    std::filesystem::remove(entry.path(), ec);
+                }
+            }
+            std::lock_guard lock(statsMutex_);
+            stats_ = {};
+        }
+
+        [[nodiscard]] std::filesystem::path entryPath(const std::filesystem::path &sourcePath) const {
+            std::error_code ec;
+            std::filesystem::path absolute = std::filesystem::absolute(sourcePath, ec);
+            const std::string key = (ec ? sourcePath : absolute).lexically_normal().string();
+            return directory_ / std::format("{:016x}.fgc", StringUtils::hash(key));
+        }
+
+    private:
+        static SourceStamp stampOf(const std::filesystem::path &sourcePath) {
+            std::error_code ec;
+            SourceStamp stamp;
+            stamp.size = std::filesystem::file_size(sourcePath, ec);
+            if (ec) {
+                return {};
+            }
+            stamp.time = std::filesystem::last_write_time(sourcePath, ec).time_since_epoch().count();
+            return stamp;
+        }
+
+        static std::shared_ptr<const MappedFile> mapEntry(const std::filesystem::path &entry) {
+            std::error_code ec;
+            if (!std::filesystem::exists(entry, ec)) {
+                return nullptr;
+            }
+            try {
+                return std::make_shared<const MappedFile>(entry);
+            } catch (const std::runtime_error &) {
+                return nullptr;
+            }
+        }
+
+        static std::optional<Header> readHeader(const MappedFile &mapping) {
+            Header header;
+            if (mapping.size() < sizeof(Header)) {
+                return std::nullopt;
+            }
+            std::memcpy(&header, mapping.data(), sizeof(Header));
+            if (header.magic != kMagic || header.version != kVersion || header.sectionCount != kSectionCount) {
+                return std::nullopt;
+            }
+            return header;
+        }
+
+        static std::shared_ptr<const ComponentDefinition> restore(const std::shared_ptr<const MappedFile> &mapping,
+                                                                  const Header &header) {
+            const size_t spanCount = static_cast<size_t>(header.sectionCount) + header.propCount;
+            if (mapping->size() < sizeof(Header) + spanCount * sizeof(Span)) {
+                return nullptr;
+            }
+
+            std::vector<std::string_view> views;
+            views.reserve(spanCount);
+            const char *spans = mapping->data() + sizeof(Header);
+            for (size_t i = 0; i < spanCount; ++i) {
+                Span span;
+                std::memcpy(&span, spans + i * sizeof(Span), sizeof(Span));
+                if (static_cast<size_t>(span.offset) + span.length > mapping->size()) {
+                    warn("Discarding corrupt component cache entry");
+                    return nullptr;
+                }
+                views.emplace_back(mapping->data() + span.offset, span.length);
+            }
+
+            ComponentSections sections;
+            sections.templateContent = views[kTemplate];
+            sections.css = views[kCss];
+            sections.javascript = views[kJavascript];
+            sections.serializedTemplate = views[kSerializedTemplate];
+            sections.props.assign(views.begin() + kSectionCount, views.end());
+            return std::make_shared<const ComponentDefinition>(std::string{views[kName]}, std::move(sections), mapping);
+        }
+
+        void store(const std::filesystem::path &entry, const ComponentDefinition &definition,
+                   const SourceStamp &stamp, const uint64_t contentHash) const {
+            std::vector<std::string_view> views{
+                definition.getName(),
+                definition.getTemplate(),
+                definition.getCss(),
+                definition.getJavascript(),
+                definition.getSerializedTemplate()
+            };
+            views.insert(views.end(), definition.getProps().begin(), definition.getProps().end());
+
+            Header header;
+            header.magic = kMagic;
+            header.version = kVersion;
+            header.sourceSize = stamp.size;
+            header.sourceTime = stamp.time;
+            header.contentHash = contentHash;
+            header.sectionCount = kSectionCount;
+            header.propCount = static_cast<uint32_t>(definition.getProps().size());
+
+            std::vector<Span> spans;
+            spans.reserve(views.size());
+            size_t offset = sizeof(Header) + views.size() * sizeof(Span);
+            for (const auto &view: views) {
+                spans.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(view.size())});
+                offset += view.size();
+            }
+
+            std::vector<std::string_view> parts{
+                {reinterpret_cast<const char *>(&header), sizeof(Header)},
+                {reinterpret_cast<const char *>(spans.data()), spans.size() * sizeof(Span)}
+            };
+            parts.insert(parts.end(), views.begin(), views.end());
+            publish(entry, parts);
+        }
+
+        // The content is unchanged but the file was touched; update the stamp so the next load is a fast hit. The
+        // entry is rewritten through publish() rather than patched in place, since other loads may have it mapped.
+        static void refreshStamp(const std::filesystem::path &entry, const MappedFile &mapping, Header header,
+                                 const SourceStamp &stamp) {
+            header.sourceSize = stamp.size;
+            header.sourceTime = stamp.time;
+            publish(entry, {
+                        {reinterpret_cast<const char *>(&header), sizeof(Header)},
+                        {mapping.data() + sizeof(Header), mapping.size() - sizeof(Header)}
+                    });
+        }
+
+        // Writes parts to a file next to the entry and renames it over the entry, so readers never observe a
+        // partially written file.
+        static void publish(const std::filesystem::path &entry, const std::vector<std::string_view> &parts) {
+            const std::filesystem::path tmpPath = entry.string() + "." + FileUtils::generateRandomString(8) + ".tmp";
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) {
+                    error("Could not write component cache entry {}", tmpPath.string());
+                    return;
+                }
+                for (const auto &part: parts) {
+                    file.write(part.data(), static_cast<std::streamsize>(part.size()));
+                }
+                if (!file.good()) {
+                    error("Failed writing component cache entry {}", tmpPath.string());
+                    file.close();
+                    std::error_code ec;
+                    std::filesystem::remove(tmpPath, ec);
+                    return;
+                }
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmpPath, entry, ec);
+            if (ec) {
+                error("Failed to publish component cache entry {}: {}", entry.string(), ec.message());
+                std::filesystem::remove(tmpPath, ec);
+            }
+        }
+
+        void record(const Clock::time_point start, const bool warm) {
+            const double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            std::lock_guard lock(statsMutex_);
+            if (warm) {
+                ++stats_.warmLoads;
+                stats_.warmMs += elapsedMs;
+            } else {
+                ++stats_.coldLoads;
+                stats_.coldMs += elapsedMs;
+            }
+        }
+    };
+}
+
+#endif //COMPONENTCACHE_HPP
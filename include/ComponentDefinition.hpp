@@ -0,0 +1,130 @@
+#pragma once
+
+#ifndef COMPONENTDEFINITION_HPP
+#define COMPONENTDEFINITION_HPP
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FileUtils.hpp"
+#include "HtmlUtility.hpp"
+#include "MappedFile.hpp"
+#include "SfcParser.hpp"
+
+namespace groklab {
+    // Sections of a component as views into some external storage, e.g. a memory-mapped cache entry.
+    struct ComponentSections {
+        std::string_view templateContent{};
+        std::string_view css{};
+        std::string_view javascript{};
+        std::string_view serializedTemplate{};
+        std::vector<std::string_view> props{};
+    };
+
+    // Immutable, shareable result of parsing one .vue file. Component instances only hold a pointer to it,
+    // so the source buffer, the extracted sections and the parsed template DOM exist once per component type.
+    class ComponentDefinition {
+        std::string name_;
+        SfcDescriptor sfc_;
+        std::shared_ptr<const MappedFile> mapping_;
+        std::string_view template_;
+        std::string_view javascript_;
+        std::string_view css_;
+        std::string ownedCss_;
+        std::vector<std::string_view> props_;
+        bool serializedFromCache_{false};
+        mutable std::once_flag serializedOnce_;
+        mutable std::string ownedSerializedTemplate_;
+        mutable std::string_view serializedTemplate_;
+        mutable std::once_flag documentOnce_;
+        mutable std::unique_ptr<const HtmlUtility> document_;
+
+    public:
+        ComponentDefinition(std::string name, std::string source)
+            : name_(std::move(name)), sfc_(std::move(source)) {
+            template_ = sfc_.getTemplateContent();
+            javascript_ = SfcDescriptor::exportDefaultBody(sfc_.getScriptContent());
+            props_ = SfcDescriptor::propNames(javascript_);
+
+            // A single style block is the common case and can stay a view; several blocks are joined once.
+            if (const auto styles = sfc_.getStyleBlocks(); styles.size() == 1) {
+                css_ = styles.front()->content;
+            } else {
+                for (const SfcBlock *style: styles) {
+                    ownedCss_.append(style->content);
+                }
+                css_ = ownedCss_;
+            }
+        }
+
+        // Builds a definition whose sections point into `mapping`, which is kept alive by the definition.
+        ComponentDefinition(std::string name, ComponentSections sections, std::shared_ptr<const MappedFile> mapping)
+            : name_(std::move(name)), mapping_(std::move(mapping)), template_(sections.templateContent),
+              javascript_(sections.javascript), css_(sections.css), props_(std::move(sections.props)),
+              serializedFromCache_(true), serializedTemplate_(sections.serializedTemplate) {
+        }
+
+        ComponentDefinition(const ComponentDefinition &) = delete;
+        ComponentDefinition &operator=(const ComponentDefinition &) = delete;
+
+        static std::shared_ptr<const ComponentDefinition> fromFile(const std::filesystem::path &filePath) {
+            return std::make_shared<const ComponentDefinition>(filePath.stem().string(),
+                                                               FileUtils::readFileAsString(filePath.string()));
+        }
+
+        [[nodiscard]] const std::string &getName() const {
+            return name_;
+        }
+
+        [[nodiscard]] std::string_view getTemplate() const {
+            return template_;
+        }
+
+        [[nodiscard]] std::string_view getCss() const {
+            return css_;
+        }
+
+        [[nodiscard]] std::string_view getJavascript() const {
+            return javascript_;
+        }
+
+        [[nodiscard]] const std::vector<std::string_view> &getProps() const {
+            return props_;
+        }
+
+        // Empty for definitions restored from the on-disk cache, which no longer carry the raw source.
+        [[nodiscard]] const SfcDescriptor &getSfc() const {
+            return sfc_;
+        }
+
+        [[nodiscard]] bool isFromCache() const {
+            return serializedFromCache_;
+        }
+
+        // The template DOM is parsed on first use and then shared read-only by every instance.
+        [[nodiscard]] const HtmlUtility &getDocument() const {
+            std::call_once(documentOnce_, [this] {
+                document_ = std::make_unique<const HtmlUtility>(std::string{template_});
+            });
+            return *document_;
+        }
+
+        // Template markup normalized by lexbor; cached definitions return it without parsing anything.
+        [[nodiscard]] std::string_view getSerializedTemplate() const {
+            if (serializedFromCache_) {
+                return serializedTemplate_;
+            }
+            std::call_once(serializedOnce_, [this] {
+                ownedSerializedTemplate_ = getDocument().bodyContentToString();
+                serializedTemplate_ = ownedSerializedTemplate_;
+            });
+            return serializedTemplate_;
+        }
+    };
+}
+
+#endif //COMPONENTDEFINITION_HPP
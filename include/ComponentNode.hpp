@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef COMPONENTNODE_HPP
+#define COMPONENTNODE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace groklab {
+    // Type erased node of the component tree. Component<BaseType, PropsType> derives from it so that children of
+    // different component types can live in one tree, and so that render passes can walk the tree generically.
+    //
+    // markDirty() may be called from any thread: the dirty flags are atomic, and a render pass clears a flag
+    // before it reads the node, so a change racing with the pass is picked up by the next one. The tree itself
+    // (adding children, setDirtyHook) must only be changed on the UI thread.
+    class ComponentNode {
+    public:
+        using NodePtr = std::shared_ptr<ComponentNode>;
+
+    private:
+        uint64_t instanceId_{nextInstanceId()};
+        ComponentNode *parent_{nullptr};
+        std::atomic<bool> dirty_{true};
+        std::atomic<bool> subtreeDirty_{true};
+        // Set on the root only; runs whenever a clean tree gets its first dirty node.
+        std::function<void()> dirtyHook_;
+
+    protected:
+        std::vector<NodePtr> children_;
+
+    public:
+        ComponentNode() = default;
+
+        // Nodes are identified by address and instance id inside a tree, so they are shared, never copied.
+        ComponentNode(const ComponentNode &) = delete;
+        ComponentNode &operator=(const ComponentNode &) = delete;
+
+        virtual ~ComponentNode() = default;
+
+        template<typename ChildComponent, typename... Args>
+        std::shared_ptr<ChildComponent> addChild(Args &&... args) {
+            auto child = std::make_shared<ChildComponent>(std::forward<Args>(args)...);
+            attachChild(child);
+            return child;
+        }
+
+        // Moves child under this node, detaching it from its previous parent if it had one. The child is rendered
+        // again on the next pass even if it was rendered in its old place.
+        void attachChild(const NodePtr &child) {
+            // child may refer to an element of the old parent's children_, which the erase below destroys.
+            NodePtr attached = child;
+            if (attached->parent_ != nullptr) {
+                std::erase(attached->parent_->children_, attached);
+            }
+            attached->parent_ = this;
+            children_.emplace_back(attached);
+            attached->dirty_.store(true, std::memory_order_release);
+            attached->subtreeDirty_.store(true, std::memory_order_release);
+            propagateSubtreeDirty(this);
+        }
+
+        [[nodiscard]] const std::vector<NodePtr> &getChildren() const {
+            return children_;
+        }
+
+        [[nodiscard]] ComponentNode *getParent() const {
+            return parent_;
+        }
+
+        [[nodiscard]] uint64_t getInstanceId() const {
+            return instanceId_;
+        }
+
+        // Called when the tree under this root needs a render pass, e.g. FluidUI::requestFrame(). Set it on the UI
+        // thread before other threads change the tree.
+        void setDirtyHook(std::function<void()> hook) {
+            dirtyHook_ = std::move(hook);
+        }
+
+        // Value of the data-fluid-id attribute the page runtime uses to find this instance.
+        [[nodiscard]] std::string getDomId() const {
+            return "fluid-" + std::to_string(instanceId_);
+        }
+
+        // Flags this node for the next render pass and marks every ancestor as having a dirty descendant.
+        // Propagation stops at the first ancestor that is already marked, so repeated updates are O(1).
+        void markDirty() {
+            dirty_.store(true, std::memory_order_release);
+            propagateSubtreeDirty(this);
+        }
+
+        [[nodiscard]] bool isDirty() const {
+            return dirty_.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] bool isSubtreeDirty() const {
+            return subtreeDirty_.load(std::memory_order_acquire);
+        }
+
+        virtual void render() = 0;
+
+        virtual void mounted() {
+            for (const auto &child: children_) {
+                child->mounted();
+            }
+        }
+
+        virtual void updated() {
+            for (const auto &child: children_) {
+                child->updated();
+            }
+        }
+
+        // Appends this node's current props and state as one JSON patch object.
+        virtual void appendPatch(std::string &out) const = 0;
+
+        // Appends the markup of this node and its children. The page runtime applies patches to the element
+        // carrying this node's data-fluid-id.
+        virtual void appendMarkup(std::string &out) const = 0;
+
+    protected:
+        friend class RenderPass;
+
+        // Returns whether the node was dirty. Cleared before the node is rendered, so a concurrent markDirty()
+        // is never lost.
+        bool takeDirty() {
+            return dirty_.exchange(false, std::memory_order_acq_rel);
+        }
+
+        // Cleared before the children are visited, for the same reason.
+        void clearSubtreeDirty() {
+            subtreeDirty_.store(false, std::memory_order_release);
+        }
+
+    private:
+        static void propagateSubtreeDirty(ComponentNode *node) {
+            for (; node != nullptr; node = node->parent_) {
+                if (node->subtreeDirty_.exchange(true, std::memory_order_acq_rel)) {
+                    return;
+                }
+                if (node->parent_ == nullptr && node->dirtyHook_) {
+                    node->dirtyHook_();
+                }
+            }
+        }
+
+        static uint64_t nextInstanceId() {
+            static std::atomic<uint64_t> counter{0};
+            return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+    };
+}
+
+#endif //COMPONENTNODE_HPP
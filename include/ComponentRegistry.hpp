@@ -0,0 +1,126 @@
+#pragma once
+
+#ifndef COMPONENTREGISTRY_HPP
+#define COMPONENTREGISTRY_HPP
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "ComponentCache.hpp"
+#include "ComponentDefinition.hpp"
+#include "Log.hpp"
+
+namespace groklab {
+    // Process wide flyweight cache of component definitions keyed by component name or file path.
+    class ComponentRegistry {
+        using DefinitionPtr = std::shared_ptr<const ComponentDefinition>;
+
+        mutable std::shared_mutex mutex_;
+        std::unordered_map<std::string, DefinitionPtr> definitions_;
+        std::filesystem::path basePath_{"./web/vue/"};
+        // Shared so a load in flight keeps the cache it started with alive across enableDiskCache().
+        std::shared_ptr<ComponentCache> diskCache_;
+
+    public:
+        ComponentRegistry() = default;
+
+        ComponentRegistry(const ComponentRegistry &) = delete;
+        ComponentRegistry &operator=(const ComponentRegistry &) = delete;
+
+        static ComponentRegistry &instance() {
+            static ComponentRegistry registry;
+            return registry;
+        }
+
+        void setBasePath(std::filesystem::path basePath) {
+            std::unique_lock lock(mutex_);
+            basePath_ = std::move(basePath);
+        }
+
+        // Persists parsed definitions under `directory` so later launches can skip parsing entirely.
+        void enableDiskCache(const std::filesystem::path &directory) {
+            std::unique_lock lock(mutex_);
+            diskCache_ = std::make_shared<ComponentCache>(directory);
+        }
+
+        [[nodiscard]] std::shared_ptr<ComponentCache> getDiskCache() const {
+            std::shared_lock lock(mutex_);
+            return diskCache_;
+        }
+
+        // Resolves `<basePath>/<componentName>.vue`, parsing it only the first time the name is requested.
+        [[nodiscard]] DefinitionPtr get(const std::string &componentName) {
+            std::filesystem::path fullPath;
+            {
+                std::shared_lock lock(mutex_);
+                if (const auto it = definitions_.find(componentName); it != definitions_.end()) {
+                    return it->second;
+                }
+                fullPath = basePath_ / (componentName + ".vue");
+            }
+            return insert(componentName, loadDefinition(fullPath));
+        }
+
+        [[nodiscard]] DefinitionPtr load(const std::filesystem::path &filePath) {
+            const std::string key = filePath.lexically_normal().string();
+            if (auto definition = find(key)) {
+                return definition;
+            }
+            return insert(key, loadDefinition(filePath));
+        }
+
+        // Registers a definition built from in-memory source; an existing entry with the same name wins.
+        DefinitionPtr define(const std::string &componentName, std::string source) {
+            if (auto definition = find(componentName)) {
+                return definition;
+            }
+            return insert(componentName, std::make_shared<const ComponentDefinition>(componentName, std::move(source)));
+        }
+
+        [[nodiscard]] DefinitionPtr find(const std::string &key) const {
+            std::shared_lock lock(mutex_);
+            const auto it = definitions_.find(key);
+            return it == definitions_.end() ? nullptr : it->second;
+        }
+
+        [[nodiscard]] size_t size() const {
+            std::shared_lock lock(mutex_);
+            return definitions_.size();
+        }
+
+        void erase(const std::string &key) {
+            std::unique_lock lock(mutex_);
+            definitions_.erase(key);
+        }
+
+        void clear() {
+            std::unique_lock lock(mutex_);
+            definitions_.clear();
+        }
+
+    private:
+        [[nodiscard]] DefinitionPtr loadDefinition(const std::filesystem::path &filePath) const {
+            if (const auto cache = getDiskCache()) {
+                return cache->load(filePath);
+            }
+            return ComponentDefinition::fromFile(filePath);
+        }
+
+        // Parsing happens outside the lock; if another thread registered the same key meanwhile, keep theirs.
+        DefinitionPtr insert(const std::string &key, DefinitionPtr definition) {
+            std::unique_lock lock(mutex_);
+            const auto [it, inserted] = definitions_.try_emplace(key, std::move(definition));
+            if (inserted) {
+                debug("Registered component definition {}", key);
+            }
+            return it->second;
+        }
+    };
+}
+
+#endif //COMPONENTREGISTRY_HPP
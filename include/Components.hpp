@@ -5,145 +5,80 @@
 
 #include <string>
 #include <unordered_map>
-#include <sstream>
-#include <regex>
 #include <fstream>
 #include <functional>
 #include <any>
+#include <mutex>
 #include <rfl.hpp>
 #include <utility>
 
 #include "HtmlUtility.hpp"
+#include "SfcParser.hpp"
+#include "CallbackTable.hpp"
+#include "ComponentNode.hpp"
+#include "ComponentRegistry.hpp"
+#include "PropSchema.hpp"
 #include "ComponentConstants.hpp"
 
 
 namespace groklab {
-    template<class T>
-    class InputValue {
-        static_assert(std::is_integral_v<T> || std::is_same_v<T, std::string> ||
-                      std::is_same_v<T, bool> || std::is_same_v<T, float> || std::is_same_v<T, double>,
-                      "InputValue only accepts integral types, std::string, bool, or float");
-        using Type = T;
-        std::string name_{};
-        T value_{};
-        T defaultValue_{};
-
-    public:
-        static const std::string type;
-
-        InputValue() = default;
-
-        explicit InputValue(std::string name, T value, T defaultValue = T()) :
-        name_(std::move(name)),
-        value_(std::move(value)), defaultValue_(std::move(defaultValue)) {
-        }
-
-        void setName(const std::string &name) {
-            this->name_ = name;
-        }
-
-        [[nodiscard]] std::string getName() const {
-            return name_;
-        }
-
-        [[nodiscard]] T getValue() const {
-            return value_;
-        }
-
-        void setValue(T value) {
-            this->value_ = value;
-        }
-
-        void setDefaultValue(T defaultValue) {
-            this->defaultValue_ = defaultValue;
-        }
-
-        [[nodiscard]] T getDefaultValue() const {
-            return defaultValue_;
-        }
-
-        // Define comparison operators
-        bool operator<(const InputValue &other) const {
-            return std::tie(name_, value_) < std::tie(other.name_, other.value_);
-        }
-
-        bool operator==(const InputValue &other) const {
-            return std::tie(name_, value_) == std::tie(other.name_, other.value_);
-        }
-    };
-
-    template<typename BaseType>
-    class Component {
+    template<typename BaseType, typename PropsType = NoProps>
+    class Component : public ComponentNode {
     public:
+        using Props = PropsType;
         using State = std::unordered_map<std::string, std::string>;
-        using FunctionMap = std::map<std::string, std::function<void()> >;
-        using ComponentPtr = std::shared_ptr<Component>;
-        using InputValueVariant = std::variant<
-            InputValue<char>,
-            InputValue<unsigned char>,
-            InputValue<int>,
-            InputValue<unsigned int>,
-            InputValue<short>,
-            InputValue<unsigned short>,
-            InputValue<long>,
-            InputValue<unsigned long>,
-            InputValue<long long>,
-            InputValue<unsigned long long>,
-            InputValue<std::string>,
-            InputValue<bool>,
-            InputValue<float>,
-            InputValue<double>,
-            InputValue<size_t>
-        >;
-        using InputValueSet = std::set<InputValueVariant>;
+        using FunctionMap = CallbackTable;
+        using ComponentPtr = NodePtr;
+        using DefinitionPtr = std::shared_ptr<const ComponentDefinition>;
 
     protected:
+        // Guards state_ and props_, which setters may change from any thread while a render pass reads them.
+        mutable std::mutex mutex_;
         State state_;
         std::string name_;
-        std::string template_;
-        std::string css_;
-        std::string javascript_;
+        DefinitionPtr definition_;
         FunctionMap functionMap_;
-        std::vector<ComponentPtr> children_;
-        InputValueSet inputValues_;
-        std::unique_ptr<HtmlUtility> htmlUtility_;
-        std::string scope_{};
+        PropsType props_{};
+        mutable std::string scope_{};
 
     public:
-        explicit Component(std::string componentName) : name_(std::move(componentName)) {
-            const std::string componentNameVue = name_ + ".vue";
-            const std::filesystem::path basePath("./web/vue/");
-            const std::filesystem::path fullPath = basePath / componentNameVue;
-            initFromVueFile(fullPath);
+        explicit Component(std::string componentName, PropsType props = {})
+            : name_(std::move(componentName)), definition_(ComponentRegistry::instance().get(name_)),
+              props_(std::move(props)) {
         }
 
-        explicit Component(const std::filesystem::path &filePath) : name_(filePath.stem().string()) {
-            initFromVueFile(filePath);
+        explicit Component(const std::filesystem::path &filePath)
+            : name_(filePath.stem().string()), definition_(ComponentRegistry::instance().load(filePath)) {
         }
 
-        explicit Component(const std::string &content, std::string componentName) : name_(std::move(componentName)) {
-            initFromVueString(content);
+        explicit Component(const std::string &content, std::string componentName)
+            : name_(std::move(componentName)),
+              definition_(std::make_shared<const ComponentDefinition>(name_, content)) {
         }
 
-        Component() = default;
-
-        virtual ~Component() = default;
-
-        template<typename ChildComponent, typename... Args>
-        void addChild(Args &&... args) {
-            auto child = std::make_shared<ChildComponent>(std::forward<Args>(args)...);
-            children_.emplace_back(std::move(child));
+        explicit Component(DefinitionPtr definition)
+            : name_(definition->getName()), definition_(std::move(definition)) {
         }
 
-        [[nodiscard]] const std::vector<ComponentPtr> &getChildren() const {
-            return children_;
-        }
+        Component() = default;
+
+        ~Component() override = default;
 
+        // Changing state schedules this component for the next incremental render pass; safe from any thread.
         void setState(const std::string &key, const std::string &value) {
-            state_[key] = value;
+            {
+                std::lock_guard lock(mutex_);
+                auto [it, inserted] = state_.try_emplace(key, value);
+                if (!inserted && it->second == value) {
+                    return;
+                }
+                it->second = value;
+            }
+            markDirty();
         }
 
         [[nodiscard]] std::string getState(const std::string &key) const {
+            std::lock_guard lock(mutex_);
             auto it = state_.find(key);
             if (it != state_.end()) {
                 return it->second;
@@ -158,167 +93,114 @@ namespace groklab {
             return scope_;
         }
 
-        void addInputValue(const InputValueVariant &inputValue) {
-            inputValues_.insert(inputValue);
+        // Returns a reference without locking; only read props this way on the thread that sets them.
+        [[nodiscard]] const PropsType &getProps() const {
+            return props_;
         }
 
-        [[nodiscard]] const InputValueSet &getInputValues() const {
-            return inputValues_;
-        }
-
-        [[nodiscard]] std::optional<InputValueVariant> getInputValues(const std::string &name) const {
-            for (const auto &inputValue: inputValues_) {
-                if (std::visit([&](const auto &val) { return val.getName() == name; }, inputValue)) {
-                    return inputValue;
-                }
+        void setProps(PropsType props) {
+            {
+                std::lock_guard lock(mutex_);
+                props_ = std::move(props);
             }
-            return std::nullopt;
-        }
-
-        virtual void render() {
-            compose();
-
-        }
-
-        [[nodiscard]] std::string getName() const {
-            return name_;
+            markDirty();
         }
 
-        [[nodiscard]] std::string getTemplate() const {
-            return template_;
+        // Typed, copy free access to one prop resolved at compile time, e.g. getProp<"text">(). Like getProps(),
+        // only use it on the thread that sets props.
+        template<rfl::internal::StringLiteral field>
+        [[nodiscard]] const auto &getProp() const {
+            const auto view = rfl::to_view(props_);
+            return *rfl::get<field>(view);
         }
 
-        [[nodiscard]] std::string getCss() const {
-            return css_;
-        }
-
-        [[nodiscard]] std::string getJavascript() const {
-            return javascript_;
+        template<rfl::internal::StringLiteral field, typename Value>
+        void setProp(Value &&value) {
+            {
+                std::lock_guard lock(mutex_);
+                auto view = rfl::to_view(props_);
+                *rfl::get<field>(view) = std::forward<Value>(value);
+            }
+            markDirty();
         }
 
-        template<typename Func>
-        void addFunction(const std::string &name, Func &&func) {
-            functionMap_[name] = [func = std::forward<Func>(func)]() mutable {
-                func(); // Calls the stored function
-            };
+        void render() override {
+            compose();
         }
 
-        template<typename... Args>
-        void callFunction(const std::string &name, Args &&... args) {
-            // If the function exists, cast it to a callable with matching arguments
-            if (auto it = functionMap_.find(name); it != functionMap_.end()) {
-                // Cast and call the function with forwarded arguments
-                std::invoke(it->second, std::forward<Args>(args)...);
+        void appendPatch(std::string &out) const override {
+            std::lock_guard lock(mutex_);
+            out.append(R"({"id":")").append(getDomId()).append(R"(","props":)");
+            if constexpr (std::is_empty_v<PropsType>) {
+                out.append("{}");
             } else {
-                std::cerr << "Function '" << name << "' not found.\n";
+                out.append(rfl::json::write(props_));
             }
+            out.append(R"(,"state":)").append(rfl::json::write(state_)).append("}");
         }
 
-        virtual void mounted() {
+        // The template wrapped in an element carrying data-fluid-id, followed by the children's markup. Elements
+        // with data-fluid-bind="<name>" show the state value or prop of that name once the first patch arrives.
+        void appendMarkup(std::string &out) const override {
+            out.append(R"(<div class="fluid-component" style="display:contents" data-fluid-id=")")
+                    .append(getDomId()).append(R"(">)");
+            out.append(getTemplate());
             for (const auto &child: children_) {
-                child->mounted();
+                child->appendMarkup(out);
             }
+            out.append("</div>");
         }
 
-        virtual void updated() {
-            for (const auto &child: children_) {
-                child->updated();
-            }
+        [[nodiscard]] std::string getName() const {
+            return name_;
         }
 
-    protected:
-        std::string generateProps() {
-            std::ostringstream propsStream;
-            propsStream << "props: {\n";
-
-            for (const auto &inputValue : inputValues_) {
-                std::visit([&propsStream, this](const auto &val) {
-                    using T = std::decay_t<decltype(val)>;
-                    propsStream << "  " << this->scope_ + "_" + val.getName() << ": {\n";
-                    if constexpr (std::is_same_v<T, InputValue<std::string>>) {
-                        propsStream << "    type: String,\n";
-                    } else if constexpr (std::is_same_v<T, InputValue<int>> || std::is_same_v<T, InputValue<long>> || std::is_same_v<T, InputValue<short>>) {
-                        propsStream << "    type: Number,\n";
-                    } else if constexpr (std::is_same_v<T, InputValue<bool>>) {
-                        propsStream << "    type: Boolean,\n";
-                    } else if constexpr (std::is_same_v<T, InputValue<float>> || std::is_same_v<T, InputValue<double>>) {
-                        propsStream << "    type: Number,\n";
-                    }
-                    propsStream << "    default: " << (val.getDefaultValue().empty() ? "''" : val.getDefaultValue()) << "\n";
-                    propsStream << "  },\n";
-                }, inputValue);
-
-                return propsStream.str();
-            }
-
-            propsStream << "}\n";
-            return propsStream.str();
+        [[nodiscard]] std::string_view getTemplate() const {
+            return definition_ == nullptr ? std::string_view{} : definition_->getTemplate();
         }
 
-        void parseHtml() const {
-            HtmlUtility htmlUtility(template_);
+        [[nodiscard]] std::string_view getCss() const {
+            return definition_ == nullptr ? std::string_view{} : definition_->getCss();
         }
 
-        virtual void compose() = 0;
-
-        void initFromVueFile(const std::filesystem::path &filePath) {
-            std::ifstream file(filePath);
-            if (!file) {
-                auto msg = std::format("Could not open the file! {}", filePath.string());
-                throw std::runtime_error(msg);
-            }
-            std::stringstream buffer;
-            buffer << file.rdbuf();
-            std::string content = buffer.str();
-            name_ = filePath.stem().string();
-            initFromVueString(content);
+        [[nodiscard]] std::string_view getJavascript() const {
+            return definition_ == nullptr ? std::string_view{} : definition_->getJavascript();
         }
 
-        void initFromVueString(const std::string &content) {
-            htmlUtility_ =  std::make_unique<HtmlUtility>(content);
-            template_ = getTemplateContent(content);
-            css_ = getStyleContent(content);
-            javascript_ = getScriptContent(content);
+        [[nodiscard]] const DefinitionPtr &getDefinition() const {
+            return definition_;
         }
 
-        static std::string getTagContent(const std::string &content, const std::string &tagName) {
-            // Construct the regex pattern for the specified tag and account for multiline content
-            const std::string pattern = "<" + tagName + R"(\b[^>]*>([\s\S]*?)</)" + tagName + ">";
-
-            // Compile the regex with our pattern
-            const std::regex tagRegex(pattern, std::regex::icase);
-
-            // Search for the first match of the tag content
-            if (std::smatch matches; std::regex_search(content, matches, tagRegex)) {
-                return matches[1].str(); // Return the content inside the tag
-            }
-            return ""; // Return empty if no match found
+        template<typename Func>
+        void addFunction(const std::string &name, Func &&func) {
+            functionMap_.add(name, std::forward<Func>(func));
         }
 
-        static std::string getScriptContent(const std::string &content) {
-            // Construct the regex pattern to match content inside `export default { ... }`
-            const std::string pattern = R"(export\s+default\s+\{([\s\S]*?)\})";
-
-            // Compile the regex pattern
-            const std::regex scriptRegex(pattern, std::regex::icase); // Case insensitive
+        // Call freeze once every function is registered so that lookups use the perfect hash.
+        void freezeFunctions() {
+            functionMap_.freeze();
+        }
 
-            // Search for the match of `export default { ... }`
-            if (std::smatch matches; std::regex_search(content, matches, scriptRegex)) {
-                return matches[1].str(); // Return the content inside the `export default { ... }`
-            }
-            return ""; // Return empty if no match found
+        // Arguments must match the registered signature after decay, e.g. (int, double) for f(int, double).
+        template<typename... Args>
+        bool callFunction(const std::string_view name, Args &&... args) {
+            return functionMap_.call(name, std::forward<Args>(args)...);
         }
 
-        [[nodiscard]] std::string generateScopedName(const std::string& name) const {
-            return scope_ + "-" + name;
+        // Entry point for the webview bridge: decodes the JSON argument array and returns the JSON result.
+        std::optional<std::string> callFunctionJson(const std::string_view name, const std::string_view payload) {
+            return functionMap_.callJson(name, payload);
         }
 
-        static std::string getTemplateContent(const std::string &filePath) {
-            return getTagContent(filePath, "template");
+    protected:
+        [[nodiscard]] std::string generateProps() const {
+            return PropSchema<PropsType>::toVueProps(scope_);
         }
 
-        static std::string getStyleContent(const std::string &filePath) {
-            return getTagContent(filePath, "style");
+        virtual void compose() = 0;
+
+        [[nodiscard]] std::string generateScopedName(const std::string& name) const {
+            return scope_ + "-" + name;
         }
     };
 
@@ -362,47 +244,39 @@ namespace groklab {
             htmlUtils.setTitle("New Title");
             info("Title: {}", htmlUtils.getTitle());
             htmlUtils.initRootAppElement();
-            htmlUtils.writeToFile("./index-tmp.html");
+            htmlUtils.writeToFile("./index-tmp.html", HtmlUtility::SerializeMode::kCompact);
 
             addFunction("lambda_func", []() {
                 std::cout << "Called lambda_func with no arguments.\n";
             });
             // Add example_function and another_function
-            addFunction("example_function", [this]() { exampleFunction(42, 3.14); });
-            addFunction("another_function", [this]() { anotherFunction("Hello from map!"); });
+            addFunction("example_function", [this](int x, double y) { exampleFunction(x, y); });
+            addFunction("another_function", [this](std::string message) { anotherFunction(std::move(message)); });
+            freezeFunctions();
         }
     };
 
+    struct TextDisplayProps {
+        std::string text{};
+        TextSize size{TextSize::regular};
+        TextStyle style{TextStyle::normal};
+        TextColor color{TextColor::black};
+    };
+
     // Text component
-    class TextDisplay final : public Component<TextDisplay> {
+    class TextDisplay final : public Component<TextDisplay, TextDisplayProps> {
     public:
-        static const std::string TEXT_INPUT;
-        static const std::string SIZE_INPUT;
-        static const std::string STYLE_INPUT;
-        static const std::string COLOR_INPUT;
         TextDisplay(std::string text, TextSize textSize, TextStyle textStyle, TextColor textColor)
-        : Component(std::string{"TextDisplay"}) {
-            addInputValue(InputValue(TEXT_INPUT, std::move(text)));
-            addInputValue(InputValue(SIZE_INPUT, rfl::enum_to_string(textSize)));
-            addInputValue(InputValue(STYLE_INPUT, rfl::enum_to_string(textStyle)));
-            addInputValue(InputValue(COLOR_INPUT, rfl::enum_to_string(textColor)));
+        : Component(std::string{"TextDisplay"}, TextDisplayProps{std::move(text), textSize, textStyle, textColor}) {
         }
 
-        [[nodiscard]] std::string getText() const {
-            if (const auto value = getInputValues(TEXT_INPUT); value.has_value()) {
-                return std::get<InputValue<std::string>>(value.value()).getValue();
-            }
-            return "";
+        [[nodiscard]] const std::string &getText() const {
+            return props_.text;
         }
 
         void render() override{ };
-        void compose() {}
+        void compose() override {}
     };
-    // Definition of the static member
-    const std::string TextDisplay::TEXT_INPUT = "text";
-    const std::string TextDisplay::SIZE_INPUT = "size";
-    const std::string TextDisplay::STYLE_INPUT = "style";
-    const std::string TextDisplay::COLOR_INPUT = "color";
 }
 
 #endif // COMPONENT_HPP
@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef CSSSELECTORCACHE_HPP
+#define CSSSELECTORCACHE_HPP
+
+#include <lexbor/css/css.h>
+#include <lexbor/selectors/selectors.h>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include "Log.hpp"
+
+namespace groklab {
+    // Per-thread lexbor CSS parser, selector matcher and cache of compiled selector lists keyed by their text.
+    // A selector is parsed once per thread; later queries with the same text go straight to matching. Lexbor
+    // objects are not thread safe, hence one cache per thread rather than one shared cache.
+    class CssSelectorCache {
+        struct TransparentHash {
+            using is_transparent = void;
+
+            size_t operator()(const std::string_view text) const {
+                return std::hash<std::string_view>{}(text);
+            }
+        };
+
+        lxb_css_parser_t *parser_{nullptr};
+        lxb_selectors_t *selectors_{nullptr};
+        // Invalid selectors are cached as nullptr so they are reported once and not reparsed.
+        std::unordered_map<std::string, lxb_css_selector_list_t *, TransparentHash, std::equal_to<> > lists_;
+
+        CssSelectorCache() {
+            createParser();
+            selectors_ = lxb_selectors_create();
+            if (lxb_selectors_init(selectors_) != LXB_STATUS_OK) {
+                critical("Failed to create CSS selectors!");
+                selectors_ = lxb_selectors_destroy(selectors_, true);
+            }
+        }
+
+    public:
+        CssSelectorCache(const CssSelectorCache &) = delete;
+        CssSelectorCache &operator=(const CssSelectorCache &) = delete;
+
+        ~CssSelectorCache() {
+            releaseLists();
+            lxb_css_parser_destroy(parser_, true);
+            lxb_selectors_destroy(selectors_, true);
+        }
+
+        static CssSelectorCache &forThread() {
+            thread_local CssSelectorCache cache;
+            return cache;
+        }
+
+        // Compiled list for the selector text, or nullptr if it does not parse.
+        lxb_css_selector_list_t *compile(const std::string_view selector) {
+            if (const auto it = lists_.find(selector); it != lists_.end()) {
+                return it->second;
+            }
+            lxb_css_selector_list_t *list = nullptr;
+            if (parser_ != nullptr) {
+                list = lxb_css_selectors_parse(parser_, reinterpret_cast<const lxb_char_t *>(selector.data()),
+                                               selector.size());
+                if (lxb_css_parser_status(parser_) != LXB_STATUS_OK) {
+                    error("Invalid CSS selector '{}'", selector);
+                    list = nullptr;
+                }
+            }
+            lists_.emplace(selector, list);
+            return list;
+        }
+
+        // Calls onMatch(lxb_dom_node_t *) for every element below root that matches, in document order.
+        // Returning false from onMatch stops the search. Returns false for invalid selectors.
+        template<typename OnMatch>
+        bool find(lxb_dom_node_t *root, const std::string_view selector, OnMatch &&onMatch) {
+            lxb_css_selector_list_t *list = compile(selector);
+            if (list == nullptr || selectors_ == nullptr) {
+                return false;
+            }
+            // The specificity argument changed from pointer to value between lexbor releases; accept either.
+            const lxb_selectors_cb_f callback = [](lxb_dom_node_t *node, auto, void *ctx) -> lxb_status_t {
+                auto &target = *static_cast<std::remove_reference_t<OnMatch> *>(ctx);
+                return target(node) ? LXB_STATUS_OK : LXB_STATUS_STOP;
+            };
+            const lxb_status_t status = lxb_selectors_find(selectors_, root, list, callback, &onMatch);
+            return status == LXB_STATUS_OK || status == LXB_STATUS_STOP;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return lists_.size();
+        }
+
+        void clear() {
+            releaseLists();
+            // The parser may still refer to a released pool, so start over with a fresh one.
+            lxb_css_parser_destroy(parser_, true);
+            createParser();
+        }
+
+    private:
+        void createParser() {
+            parser_ = lxb_css_parser_create();
+            if (lxb_css_parser_init(parser_, nullptr) != LXB_STATUS_OK) {
+                critical("Failed to create CSS parser!");
+                parser_ = lxb_css_parser_destroy(parser_, true);
+            }
+        }
+
+        // Compiled lists may share one lexbor memory pool, so each pool is released exactly once.
+        void releaseLists() {
+            std::unordered_set<lxb_css_memory_t *> pools;
+            for (const auto &[text, list]: lists_) {
+                if (list != nullptr) {
+                    pools.insert(list->memory);
+                }
+            }
+            for (lxb_css_memory_t *pool: pools) {
+                lxb_css_memory_destroy(pool, true);
+            }
+            lists_.clear();
+        }
+    };
+}
+
+#endif //CSSSELECTORCACHE_HPP
@@ -0,0 +1,94 @@
+#pragma once
+
+#ifndef FRAMECLOCK_HPP
+#define FRAMECLOCK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+namespace groklab {
+    // Paces work to a frame interval. request() asks for one tick; the tick runs on the clock's thread no sooner
+    // than one interval after the previous tick, and all requests made before it are served by it. A zero
+    // interval runs the tick right away on the requesting thread.
+    class FrameClock {
+    public:
+        using Duration = std::chrono::steady_clock::duration;
+
+        // About 60 frames per second, the refresh rate webviews render at on most displays.
+        static constexpr Duration kDefaultInterval = std::chrono::microseconds(16'667);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        std::function<void()> tick_;
+        std::mutex mutex_;
+        std::condition_variable_any wake_;
+        Duration interval_;
+        bool requested_{false};
+        Clock::time_point lastTick_{};
+        // Declared last: started after, and stopped and joined before, the state above.
+        std::jthread thread_;
+
+    public:
+        explicit FrameClock(std::function<void()> tick, const Duration interval = kDefaultInterval)
+            : tick_(std::move(tick)), interval_(interval),
+              thread_([this](const std::stop_token &stop) { loop(stop); }) {
+        }
+
+        FrameClock(const FrameClock &) = delete;
+        FrameClock &operator=(const FrameClock &) = delete;
+
+        void request() {
+            {
+                std::lock_guard lock(mutex_);
+                if (interval_ != Duration::zero()) {
+                    requested_ = true;
+                    wake_.notify_one();
+                    return;
+                }
+            }
+            tick_();
+        }
+
+        void setInterval(const Duration interval) {
+            std::lock_guard lock(mutex_);
+            interval_ = std::max(Duration::zero(), interval);
+            wake_.notify_one();
+        }
+
+        [[nodiscard]] Duration getInterval() {
+            std::lock_guard lock(mutex_);
+            return interval_;
+        }
+
+    private:
+        void loop(const std::stop_token &stop) {
+            std::unique_lock lock(mutex_);
+            while (!stop.stop_requested()) {
+                if (!wake_.wait(lock, stop, [this] { return requested_; })) {
+                    return;
+                }
+                const Clock::time_point deadline = lastTick_ + interval_;
+                if (Clock::now() < deadline) {
+                    // setInterval() ends the wait early so the deadline is recomputed.
+                    wake_.wait_until(lock, stop, deadline, [this, interval = interval_] {
+                        return interval_ != interval;
+                    });
+                    continue;
+                }
+                requested_ = false;
+                lastTick_ = Clock::now();
+                lock.unlock();
+                tick_();
+                lock.lock();
+            }
+        }
+    };
+}
+
+#endif //FRAMECLOCK_HPP
@@ -0,0 +1,283 @@
+#pragma once
+
+#ifndef HEADLESSWEBVIEWBACKEND_HPP
+#define HEADLESSWEBVIEWBACKEND_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Log.hpp"
+#include "WebviewBackend.hpp"
+
+namespace groklab {
+    // Webview backend without a window. Every call is recorded with a timestamp, and page side calls into
+    // bindings are replayed from C++ with call(), so the generate, bind and update pipeline can be tested and
+    // benchmarked on a machine without a display. Scripts are recorded, not executed.
+    //
+    // The thread that calls run(), runUntilIdle() or waitForResult() plays the UI thread.
+    class HeadlessWebviewBackend final : public WebviewBackend {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class EventType {
+            kSetTitle,
+            kSetSize,
+            kSetHtml,
+            kInit,
+            kEval,
+            kBind,
+            kUnbind,
+            kCall,
+            kResolve,
+            kDispatch
+        };
+
+        struct Event {
+            EventType type;
+            // Title, HTML, script, binding name or request id, depending on the type.
+            std::string target;
+            // Request of a call, result of a resolve.
+            std::string payload;
+            int status{0};
+            // Time since the backend was created.
+            std::chrono::nanoseconds time{0};
+        };
+
+        struct Result {
+            int status{0};
+            std::string value;
+        };
+
+    private:
+        const Clock::time_point start_{Clock::now()};
+        mutable std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::vector<Event> events_;
+        std::unordered_map<std::string, Binding> bindings_;
+        std::unordered_map<std::string, Result> results_;
+        std::deque<std::function<void()> > tasks_;
+        std::string html_;
+        uint64_t nextRequestId_{1};
+        bool terminated_{false};
+
+    public:
+        HeadlessWebviewBackend() = default;
+
+        void setTitle(const std::string &title) override {
+            record(EventType::kSetTitle, title);
+        }
+
+        void setSize(const int width, const int height) override {
+            record(EventType::kSetSize, std::to_string(width) + "x" + std::to_string(height));
+        }
+
+        void setHtml(const std::string &html) override {
+            std::lock_guard lock(mutex_);
+            html_ = html;
+            recordLocked(EventType::kSetHtml, html);
+        }
+
+        void init(const std::string &script) override {
+            record(EventType::kInit, script);
+        }
+
+        void eval(const std::string &script) override {
+            record(EventType::kEval, script);
+        }
+
+        using WebviewBackend::bind;
+
+        void bind(const std::string &name, Binding binding) override {
+            std::lock_guard lock(mutex_);
+            bindings_[name] = std::move(binding);
+            recordLocked(EventType::kBind, name);
+        }
+
+        void unbind(const std::string &name) override {
+            std::lock_guard lock(mutex_);
+            bindings_.erase(name);
+            recordLocked(EventType::kUnbind, name);
+        }
+
+        void resolve(const std::string &id, const int status, const std::string &result) override {
+            {
+                std::lock_guard lock(mutex_);
+                results_[id] = {status, result};
+                recordLocked(EventType::kResolve, id, result, status);
+            }
+            wakeup_.notify_all();
+        }
+
+        void dispatch(std::function<void()> task) override {
+            {
+                std::lock_guard lock(mutex_);
+                tasks_.push_back(std::move(task));
+                recordLocked(EventType::kDispatch, {});
+            }
+            wakeup_.notify_all();
+        }
+
+        // Runs dispatched tasks until terminate() is called.
+        void run() override {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(mutex_);
+                    wakeup_.wait(lock, [&] { return terminated_ || !tasks_.empty(); });
+                    if (terminated_) {
+                        terminated_ = false;
+                        return;
+                    }
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                task();
+            }
+        }
+
+        void terminate() override {
+            {
+                std::lock_guard lock(mutex_);
+                terminated_ = true;
+            }
+            wakeup_.notify_all();
+        }
+
+        // Calls a binding the way the page would with window.<name>(...args); request is the JSON array of
+        // arguments. Runs on the calling thread and returns the request id to look up the result with.
+        std::string call(const std::string &name, const std::string &request) {
+            Binding binding;
+            std::string id;
+            {
+                std::lock_guard lock(mutex_);
+                const auto it = bindings_.find(name);
+                id = std::to_string(nextRequestId_++);
+                recordLocked(EventType::kCall, name, request);
+                if (it == bindings_.end()) {
+                    error("Headless call to unknown binding '{}'", name);
+                    results_[id] = {1, "\"Unknown binding\""};
+                    return id;
+                }
+                binding = it->second;
+            }
+            binding(id, request);
+            return id;
+        }
+
+        // Queues call() on the UI thread, e.g. to script page interaction before run().
+        void post(const std::string &name, const std::string &request) {
+            dispatch([this, name, request] { call(name, request); });
+        }
+
+        // Runs dispatched tasks until none are left; returns the number of tasks run.
+        size_t runUntilIdle() {
+            size_t count = 0;
+            while (runOne()) {
+                ++count;
+            }
+            return count;
+        }
+
+        // Runs dispatched tasks until the call with the given request id is settled or the timeout expires.
+        std::optional<Result> waitForResult(const std::string &id,
+                                            const std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+            const auto deadline = Clock::now() + timeout;
+            while (true) {
+                if (auto result = getResult(id)) {
+                    return result;
+                }
+                if (runOne()) {
+                    continue;
+                }
+                std::unique_lock lock(mutex_);
+                if (!wakeup_.wait_until(lock, deadline, [&] { return results_.contains(id) || !tasks_.empty(); })) {
+                    return std::nullopt;
+                }
+            }
+        }
+
+        [[nodiscard]] std::optional<Result> getResult(const std::string &id) const {
+            std::lock_guard lock(mutex_);
+            if (const auto it = results_.find(id); it != results_.end()) {
+                return it->second;
+            }
+            return std::nullopt;
+        }
+
+        [[nodiscard]] bool isBound(const std::string &name) const {
+            std::lock_guard lock(mutex_);
+            return bindings_.contains(name);
+        }
+
+        [[nodiscard]] std::string getHtml() const {
+            std::lock_guard lock(mutex_);
+            return html_;
+        }
+
+        [[nodiscard]] std::vector<Event> getEvents() const {
+            std::lock_guard lock(mutex_);
+            return events_;
+        }
+
+        [[nodiscard]] std::vector<Event> getEvents(const EventType type) const {
+            std::lock_guard lock(mutex_);
+            std::vector<Event> result;
+            for (const auto &event: events_) {
+                if (event.type == type) {
+                    result.push_back(event);
+                }
+            }
+            return result;
+        }
+
+        [[nodiscard]] size_t countOf(const EventType type) const {
+            std::lock_guard lock(mutex_);
+            size_t count = 0;
+            for (const auto &event: events_) {
+                count += event.type == type ? 1 : 0;
+            }
+            return count;
+        }
+
+        void clearEvents() {
+            std::lock_guard lock(mutex_);
+            events_.clear();
+            results_.clear();
+        }
+
+    private:
+        bool runOne() {
+            std::function<void()> task;
+            {
+                std::lock_guard lock(mutex_);
+                if (tasks_.empty()) {
+                    return false;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+            return true;
+        }
+
+        void record(const EventType type, std::string target) {
+            std::lock_guard lock(mutex_);
+            recordLocked(type, std::move(target));
+        }
+
+        void recordLocked(const EventType type, std::string target, std::string payload = {}, const int status = 0) {
+            events_.push_back({type, std::move(target), std::move(payload), status, Clock::now() - start_});
+        }
+    };
+}
+
+#endif //HEADLESSWEBVIEWBACKEND_HPP
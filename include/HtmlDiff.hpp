@@ -0,0 +1,332 @@
+#pragma once
+
+#ifndef HTMLDIFF_HPP
+#define HTMLDIFF_HPP
+
+#include <lexbor/html/html.h>
+#include <lexbor/dom/interfaces/element.h>
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <rfl.hpp>
+#include <rfl/json.hpp>
+#include "HtmlUtility.hpp"
+#include "StringUtils.hpp"
+
+namespace groklab {
+    enum class DomPatchType {
+        kInsert,
+        kRemove,
+        kMove,
+        kSetAttribute,
+        kRemoveAttribute,
+        kSetText
+    };
+
+    // One DOM edit. `path` holds child indices from <html> down to the node the edit applies to; for insert,
+    // remove and move it is the parent whose child list changes. Child list edits of one parent refer to its
+    // children as they were before the first edit (`from`) and to final positions (`to`). Inserts and moves go
+    // before `anchor`: an original child index, -1 for the end of the list or -2 for the node inserted at
+    // `to + 1`. Edits are applied in order by window.fluid.applyDomPatch.
+    struct DomPatchOp {
+        DomPatchType type;
+        std::vector<uint32_t> path;
+        std::optional<uint32_t> from;
+        std::optional<uint32_t> to;
+        std::optional<int64_t> anchor;
+        std::optional<std::string> name;
+        std::optional<std::string> value;
+    };
+
+    // Computes the edits turning one rendered document into another, so the page can be patched in place
+    // instead of being reloaded (which is slow for large pages and loses scroll and focus state).
+    //
+    // Children are matched by key (the key, data-key or id attribute) through a hash map, and unkeyed children
+    // in order among siblings with the same tag. Matched children that keep their relative order (the longest
+    // increasing subsequence) stay put; only the others are moved. Subtrees with equal structural hashes are
+    // skipped without being visited.
+    class HtmlDiff {
+        static constexpr int64_t kAnchorEnd = -1;
+        static constexpr int64_t kAnchorInserted = -2;
+
+        std::unordered_map<const lxb_dom_node_t *, uint64_t> hashes_;
+        std::vector<DomPatchOp> ops_;
+        std::vector<uint32_t> path_;
+        size_t visitedCount_{0};
+
+    public:
+        const std::vector<DomPatchOp> &diff(const HtmlUtility &from, const HtmlUtility &to) {
+            ops_.clear();
+            path_.clear();
+            hashes_.clear();
+            visitedCount_ = 0;
+            lxb_dom_node_t *fromRoot = documentElement(from);
+            lxb_dom_node_t *toRoot = documentElement(to);
+            if (fromRoot == nullptr || toRoot == nullptr) {
+                error("Cannot diff a document without root element");
+                return ops_;
+            }
+            hashes_.reserve(256);
+            if (hashOf(fromRoot) != hashOf(toRoot)) {
+                diffNode(fromRoot, toRoot);
+            }
+            return ops_;
+        }
+
+        [[nodiscard]] const std::vector<DomPatchOp> &getOps() const {
+            return ops_;
+        }
+
+        // Node pairs compared by the last diff; identical subtrees count as one.
+        [[nodiscard]] size_t getVisitedCount() const {
+            return visitedCount_;
+        }
+
+        [[nodiscard]] std::string toJson() const {
+            return rfl::json::write(ops_);
+        }
+
+        // Script applying the last diff in the page.
+        [[nodiscard]] std::string toScript() const {
+            return "window.fluid && window.fluid.applyDomPatch(" + toJson() + ");";
+        }
+
+    private:
+        static lxb_dom_node_t *documentElement(const HtmlUtility &html) {
+            lxb_html_document_t *document = html.getDocument();
+            if (document == nullptr) {
+                return nullptr;
+            }
+            return lxb_dom_interface_node(lxb_dom_document_element(&document->dom_document));
+        }
+
+        static std::string_view tagName(lxb_dom_node_t *node) {
+            size_t length{0};
+            const lxb_char_t *name = lxb_dom_element_qualified_name(lxb_dom_interface_element(node), &length);
+            return {reinterpret_cast<const char *>(name), name == nullptr ? 0 : length};
+        }
+
+        static std::string_view characterData(lxb_dom_node_t *node) {
+            const lexbor_str_t &data = lxb_dom_interface_character_data(node)->data;
+            return {reinterpret_cast<const char *>(data.data), data.length};
+        }
+
+        static std::string_view attributeValue(lxb_dom_attr_t *attribute) {
+            size_t length{0};
+            const lxb_char_t *value = lxb_dom_attr_value(attribute, &length);
+            return {reinterpret_cast<const char *>(value), value == nullptr ? 0 : length};
+        }
+
+        static std::string_view attributeName(lxb_dom_attr_t *attribute) {
+            size_t length{0};
+            const lxb_char_t *name = lxb_dom_attr_qualified_name(attribute, &length);
+            return {reinterpret_cast<const char *>(name), name == nullptr ? 0 : length};
+        }
+
+        static std::optional<std::string_view> keyOf(lxb_dom_node_t *node) {
+            if (node->type != LXB_DOM_NODE_TYPE_ELEMENT) {
+                return std::nullopt;
+            }
+            lxb_dom_element_t *element = lxb_dom_interface_element(node);
+            for (const std::string_view name: {"key", "data-key", "id"}) {
+                size_t length{0};
+                const lxb_char_t *value = lxb_dom_element_get_attribute(
+                    element, reinterpret_cast<const lxb_char_t *>(name.data()), name.size(), &length);
+                if (value != nullptr) {
+                    return std::string_view{reinterpret_cast<const char *>(value), length};
+                }
+            }
+            return std::nullopt;
+        }
+
+        // Node type and tag; only nodes with the same kind are matched against each other.
+        static uint64_t kindOf(lxb_dom_node_t *node) {
+            return static_cast<uint64_t>(node->type) << 32 | static_cast<uint64_t>(lxb_dom_node_tag_id(node));
+        }
+
+        static std::vector<lxb_dom_node_t *> childrenOf(lxb_dom_node_t *node) {
+            std::vector<lxb_dom_node_t *> children;
+            for (lxb_dom_node_t *child = node->first_child; child != nullptr; child = child->next) {
+                children.push_back(child);
+            }
+            return children;
+        }
+
+        // Structural hash of a subtree: kind, attributes in order, character data and the children's hashes.
+        uint64_t hashOf(lxb_dom_node_t *node) {
+            if (const auto it = hashes_.find(node); it != hashes_.end()) {
+                return it->second;
+            }
+            uint64_t hash = StringUtils::hash({reinterpret_cast<const char *>(&node->type), sizeof(node->type)});
+            if (node->type == LXB_DOM_NODE_TYPE_ELEMENT) {
+                hash = StringUtils::hash(tagName(node), hash);
+                lxb_dom_element_t *element = lxb_dom_interface_element(node);
+                for (lxb_dom_attr_t *attribute = lxb_dom_element_first_attribute(element); attribute != nullptr;
+                     attribute = lxb_dom_element_next_attribute(attribute)) {
+                    hash = StringUtils::hash(attributeName(attribute), hash ^ '=');
+                    hash = StringUtils::hash(attributeValue(attribute), hash ^ '"');
+                }
+            } else if (node->type == LXB_DOM_NODE_TYPE_TEXT || node->type == LXB_DOM_NODE_TYPE_COMMENT) {
+                hash = StringUtils::hash(characterData(node), hash);
+            }
+            for (lxb_dom_node_t *child = node->first_child; child != nullptr; child = child->next) {
+                const uint64_t childHash = hashOf(child);
+                hash = StringUtils::hash({reinterpret_cast<const char *>(&childHash), sizeof(childHash)}, hash);
+            }
+            hashes_.emplace(node, hash);
+            return hash;
+        }
+
+        void emit(const DomPatchType type) {
+            ops_.push_back({.type = type, .path = path_});
+        }
+
+        void diffNode(lxb_dom_node_t *from, lxb_dom_node_t *to) {
+            ++visitedCount_;
+            if (to->type == LXB_DOM_NODE_TYPE_TEXT || to->type == LXB_DOM_NODE_TYPE_COMMENT) {
+                if (characterData(from) != characterData(to)) {
+                    emit(DomPatchType::kSetText);
+                    ops_.back().value = std::string(characterData(to));
+                }
+                return;
+            }
+            if (to->type == LXB_DOM_NODE_TYPE_ELEMENT) {
+                diffAttributes(lxb_dom_interface_element(from), lxb_dom_interface_element(to));
+            }
+            diffChildren(from, to);
+        }
+
+        void diffAttributes(lxb_dom_element_t *from, lxb_dom_element_t *to) {
+            for (lxb_dom_attr_t *attribute = lxb_dom_element_first_attribute(to); attribute != nullptr;
+                 attribute = lxb_dom_element_next_attribute(attribute)) {
+                const std::string_view name = attributeName(attribute);
+                const std::string_view value = attributeValue(attribute);
+                size_t length{0};
+                const lxb_char_t *previous = lxb_dom_element_get_attribute(
+                    from, reinterpret_cast<const lxb_char_t *>(name.data()), name.size(), &length);
+                if (previous == nullptr || std::string_view(reinterpret_cast<const char *>(previous), length) != value) {
+                    emit(DomPatchType::kSetAttribute);
+                    ops_.back().name = std::string(name);
+                    ops_.back().value = std::string(value);
+                }
+            }
+            for (lxb_dom_attr_t *attribute = lxb_dom_element_first_attribute(from); attribute != nullptr;
+                 attribute = lxb_dom_element_next_attribute(attribute)) {
+                const std::string_view name = attributeName(attribute);
+                if (!lxb_dom_element_has_attribute(to, reinterpret_cast<const lxb_char_t *>(name.data()), name.size())) {
+                    emit(DomPatchType::kRemoveAttribute);
+                    ops_.back().name = std::string(name);
+                }
+            }
+        }
+
+        void diffChildren(lxb_dom_node_t *fromParent, lxb_dom_node_t *toParent) {
+            const std::vector<lxb_dom_node_t *> from = childrenOf(fromParent);
+            const std::vector<lxb_dom_node_t *> to = childrenOf(toParent);
+            constexpr uint32_t kUnmatched = UINT32_MAX;
+
+            // Match every new child to an old one: keyed children through the key index, the others in order
+            // among the unkeyed old children of the same kind.
+            std::unordered_map<std::string_view, uint32_t> keyed;
+            std::unordered_map<uint64_t, std::vector<uint32_t> > unkeyed;
+            for (uint32_t i = 0; i < from.size(); ++i) {
+                if (const auto key = keyOf(from[i])) {
+                    keyed.emplace(*key, i);
+                } else {
+                    unkeyed[kindOf(from[i])].push_back(i);
+                }
+            }
+            std::unordered_map<uint64_t, size_t> unkeyedCursor;
+            std::vector<uint32_t> matches(to.size(), kUnmatched);
+            std::vector<bool> used(from.size(), false);
+            for (uint32_t i = 0; i < to.size(); ++i) {
+                if (const auto key = keyOf(to[i])) {
+                    if (const auto it = keyed.find(*key); it != keyed.end() && !used[it->second] &&
+                                                          kindOf(from[it->second]) == kindOf(to[i])) {
+                        matches[i] = it->second;
+                    }
+                } else if (const auto it = unkeyed.find(kindOf(to[i])); it != unkeyed.end()) {
+                    size_t &cursor = unkeyedCursor[it->first];
+                    if (cursor < it->second.size()) {
+                        matches[i] = it->second[cursor++];
+                    }
+                }
+                if (matches[i] != kUnmatched) {
+                    used[matches[i]] = true;
+                }
+            }
+
+            for (uint32_t i = 0; i < from.size(); ++i) {
+                if (!used[i]) {
+                    emit(DomPatchType::kRemove);
+                    ops_.back().from = i;
+                }
+            }
+
+            // Right to left, every child not in the stable subsequence is placed before its final right neighbour.
+            const std::vector<bool> stable = longestIncreasingRun(matches, kUnmatched);
+            for (uint32_t i = static_cast<uint32_t>(to.size()); i-- > 0;) {
+                if (matches[i] != kUnmatched && stable[i]) {
+                    continue;
+                }
+                const int64_t anchor = i + 1 == to.size()
+                                           ? kAnchorEnd
+                                           : matches[i + 1] == kUnmatched
+                                                 ? kAnchorInserted
+                                                 : static_cast<int64_t>(matches[i + 1]);
+                if (matches[i] == kUnmatched) {
+                    emit(DomPatchType::kInsert);
+                    ops_.back().value = HtmlUtility::nodeToCompactString(to[i]);
+                } else {
+                    emit(DomPatchType::kMove);
+                    ops_.back().from = matches[i];
+                }
+                ops_.back().to = i;
+                ops_.back().anchor = anchor;
+            }
+
+            // The child list now has the new order, so nested edits address children by their new index.
+            for (uint32_t i = 0; i < to.size(); ++i) {
+                if (matches[i] != kUnmatched && hashOf(from[matches[i]]) != hashOf(to[i])) {
+                    path_.push_back(i);
+                    diffNode(from[matches[i]], to[i]);
+                    path_.pop_back();
+                }
+            }
+        }
+
+        // Marks the entries forming a longest strictly increasing subsequence of the matched old indices.
+        static std::vector<bool> longestIncreasingRun(const std::vector<uint32_t> &values, const uint32_t skip) {
+            std::vector<uint32_t> tails;
+            std::vector<uint32_t> tailIndex;
+            std::vector<int64_t> previous(values.size(), -1);
+            for (uint32_t i = 0; i < values.size(); ++i) {
+                if (values[i] == skip) {
+                    continue;
+                }
+                const size_t length = std::lower_bound(tails.begin(), tails.end(), values[i]) - tails.begin();
+                if (length > 0) {
+                    previous[i] = tailIndex[length - 1];
+                }
+                if (length == tails.size()) {
+                    tails.push_back(values[i]);
+                    tailIndex.push_back(i);
+                } else {
+                    tails[length] = values[i];
+                    tailIndex[length] = i;
+                }
+            }
+            std::vector<bool> result(values.size(), false);
+            for (int64_t i = tailIndex.empty() ? -1 : static_cast<int64_t>(tailIndex.back()); i >= 0; i = previous[i]) {
+                result[i] = true;
+            }
+            return result;
+        }
+    };
+}
+
+#endif //HTMLDIFF_HPP
@@ -0,0 +1,254 @@
+#pragma once
+
+#ifndef HTMLTAGS_HPP
+#define HTMLTAGS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace groklab {
+    enum class HtmlTag {
+        A,
+        ABBR,
+        ACRONYM,
+        ADDRESS,
+        APPLET,
+        AREA,
+        ARTICLE,
+        ASIDE,
+        AUDIO,
+        B,
+        BASE,
+        BASEFONT,
+        BDI,
+        BDO,
+        BIG,
+        BLOCKQUOTE,
+        BODY,
+        BR,
+        BUTTON,
+        CANVAS,
+        CAPTION,
+        CENTER,
+        CITE,
+        CODE,
+        COL,
+        COLGROUP,
+        DATA,
+        DATALIST,
+        DD,
+        DEL,
+        DETAILS,
+        DFN,
+        DIALOG,
+        DIR,
+        DIV,
+        DL,
+        DT,
+        EM,
+        EMBED,
+        FIELDSET,
+        FIGCAPTION,
+        FIGURE,
+        FONT,
+        FOOTER,
+        FORM,
+        FRAME,
+        FRAMESET,
+        H1,
+        H2,
+        H3,
+        H4,
+        H5,
+        H6,
+        HEAD,
+        HEADER,
+        HR,
+        HTML,
+        I,
+        IFRAME,
+        IMG,
+        INPUT,
+        INS,
+        KBD,
+        LABEL,
+        LEGEND,
+        LI,
+        LINK,
+        MAIN,
+        MAP,
+        MARK,
+        META,
+        METER,
+        NAV,
+        NOFRAMES,
+        NOSCRIPT,
+        OBJECT,
+        OL,
+        OPTGROUP,
+        OPTION,
+        OUTPUT,
+        P,
+        PARAM,
+        PICTURE,
+        PRE,
+        PROGRESS,
+        Q,
+        RP,
+        RT,
+        RUBY,
+        S,
+        SAMP,
+        SCRIPT,
+        SECTION,
+        SELECT,
+        SMALL,
+        SOURCE,
+        SPAN,
+        STRIKE,
+        STRONG,
+        STYLE,
+        SUB,
+        SUMMARY,
+        SUP,
+        SVG,
+        TABLE,
+        TBODY,
+        TD,
+        TEMPLATE,
+        TEXTAREA,
+        TFOOT,
+        TH,
+        THEAD,
+        TIME,
+        TITLE,
+        TR,
+        TRACK,
+        TT,
+        U,
+        UL,
+        VAR,
+        VIDEO,
+        WBR
+    };
+
+    // Lower case tag names, indexed by HtmlTag.
+    inline constexpr std::array<std::string_view, 122> kHtmlTagNames = {
+        "a", "abbr", "acronym", "address", "applet", "area", "article", "aside", "audio", "b", "base", "basefont",
+        "bdi", "bdo", "big", "blockquote", "body", "br", "button", "canvas", "caption", "center", "cite", "code",
+        "col", "colgroup", "data", "datalist", "dd", "del", "details", "dfn", "dialog", "dir", "div", "dl", "dt",
+        "em", "embed", "fieldset", "figcaption", "figure", "font", "footer", "form", "frame", "frameset", "h1", "h2",
+        "h3", "h4", "h5", "h6", "head", "header", "hr", "html", "i", "iframe", "img", "input", "ins", "kbd", "label",
+        "legend", "li", "link", "main", "map", "mark", "meta", "meter", "nav", "noframes", "noscript", "object", "ol",
+        "optgroup", "option", "output", "p", "param", "picture", "pre", "progress", "q", "rp", "rt", "ruby", "s",
+        "samp", "script", "section", "select", "small", "source", "span", "strike", "strong", "style", "sub",
+        "summary", "sup", "svg", "table", "tbody", "td", "template", "textarea", "tfoot", "th", "thead", "time",
+        "title", "tr", "track", "tt", "u", "ul", "var", "video", "wbr"
+    };
+
+    // Compile time perfect hash (hash and displace) from tag name to HtmlTag. Names are first spread over a few
+    // buckets; each bucket then gets the displacement seed that moves all of its names to free slots. The compiler
+    // runs the search, so a lookup is two case-insensitive hashes, one slot probe and one compare, and it never
+    // allocates.
+    class HtmlTagIndex {
+        static constexpr size_t kBucketCount = 64;
+        static constexpr size_t kSlotCount = 256;
+        static constexpr uint8_t kEmptySlot = UINT8_MAX;
+
+        std::array<uint16_t, kBucketCount> displacements_{};
+        std::array<uint8_t, kSlotCount> slots_{};
+
+        static constexpr char toLower(const char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        static constexpr uint64_t hash(const std::string_view name, const uint64_t seed) {
+            uint64_t h = 14695981039346656037ull ^ (seed * 0x9E3779B97F4A7C15ull);
+            for (const char c: name) {
+                h ^= static_cast<unsigned char>(toLower(c));
+                h *= 1099511628211ull;
+            }
+            return h ^ (h >> 29);
+        }
+
+        static constexpr bool equalsIgnoreCase(const std::string_view name, const std::string_view lowerName) {
+            if (name.size() != lowerName.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < name.size(); ++i) {
+                if (toLower(name[i]) != lowerName[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Places the names of one bucket with the first displacement that hits only free, distinct slots.
+        constexpr bool place(const size_t bucket) {
+            for (uint16_t displacement = 1; displacement < UINT16_MAX; ++displacement) {
+                std::array<uint8_t, kSlotCount> trial = slots_;
+                bool placed = true;
+                for (size_t i = 0; i < kHtmlTagNames.size() && placed; ++i) {
+                    if (hash(kHtmlTagNames[i], 0) % kBucketCount != bucket) {
+                        continue;
+                    }
+                    uint8_t &slot = trial[hash(kHtmlTagNames[i], displacement) % kSlotCount];
+                    placed = slot == kEmptySlot;
+                    slot = static_cast<uint8_t>(i);
+                }
+                if (placed) {
+                    slots_ = trial;
+                    displacements_[bucket] = displacement;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        constexpr HtmlTagIndex() {
+            slots_.fill(kEmptySlot);
+            std::array<size_t, kBucketCount> sizes{};
+            for (const auto name: kHtmlTagNames) {
+                ++sizes[hash(name, 0) % kBucketCount];
+            }
+            // Largest buckets first, while most slots are still free.
+            for (size_t size = kHtmlTagNames.size(); size > 0; --size) {
+                for (size_t bucket = 0; bucket < kBucketCount; ++bucket) {
+                    if (sizes[bucket] == size && !place(bucket)) {
+                        throw "No perfect hash for the HTML tag table";
+                    }
+                }
+            }
+        }
+
+        [[nodiscard]] constexpr std::optional<HtmlTag> find(const std::string_view name) const {
+            const uint16_t displacement = displacements_[hash(name, 0) % kBucketCount];
+            const uint8_t index = slots_[hash(name, displacement) % kSlotCount];
+            if (index == kEmptySlot || !equalsIgnoreCase(name, kHtmlTagNames[index])) {
+                return std::nullopt;
+            }
+            return static_cast<HtmlTag>(index);
+        }
+    };
+
+    inline constexpr HtmlTagIndex kHtmlTagIndex{};
+
+    static_assert(kHtmlTagNames.size() == static_cast<size_t>(HtmlTag::WBR) + 1, "Tag name table out of sync");
+    static_assert(kHtmlTagIndex.find("blockquote") == HtmlTag::BLOCKQUOTE && kHtmlTagIndex.find("DIV") == HtmlTag::DIV);
+    static_assert(!kHtmlTagIndex.find("q-app").has_value());
+
+    // Case-insensitive tag name to HtmlTag lookup.
+    constexpr std::optional<HtmlTag> htmlTagFromName(const std::string_view name) {
+        return kHtmlTagIndex.find(name);
+    }
+
+    constexpr std::string_view toString(const HtmlTag val) {
+        return kHtmlTagNames[static_cast<size_t>(val)];
+    }
+}
+
+#endif //HTMLTAGS_HPP
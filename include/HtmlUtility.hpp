@@ -5,142 +5,89 @@
 
 #include <lexbor/html/html.h>
 #include <lexbor/dom/interfaces/element.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
 #include <string>
-#include <rfl.hpp>
+#include <string_view>
+#include <type_traits>
+#include "CssSelectorCache.hpp"
 #include "FileUtils.hpp"
+#include "HtmlTags.hpp"
+#include "MappedFile.hpp"
 #include "Log.hpp"
 #include "StringUtils.hpp"
+#include "ThreadPool.hpp"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace groklab {
 
-    enum class HtmlTag {
-        A,
-        ABBR,
-        ACRONYM,
-        ADDRESS,
-        APPLET,
-        AREA,
-        ARTICLE,
-        ASIDE,
-        AUDIO,
-        B,
-        BASE,
-        BASEFONT,
-        BDI,
-        BDO,
-        BIG,
-        BLOCKQUOTE,
-        BODY,
-        BR,
-        BUTTON,
-        CANVAS,
-        CAPTION,
-        CENTER,
-        CITE,
-        CODE,
-        COL,
-        COLGROUP,
-        DATA,
-        DATALIST,
-        DD,
-        DEL,
-        DETAILS,
-        DFN,
-        DIALOG,
-        DIR,
-        DIV,
-        DL,
-        DT,
-        EM,
-        EMBED,
-        FIELDSET,
-        FIGCAPTION,
-        FIGURE,
-        FONT,
-        FOOTER,
-        FORM,
-        FRAME,
-        FRAMESET,
-        H1,
-        H2,
-        H3,
-        H4,
-        H5,
-        H6,
-        HEAD,
-        HEADER,
-        HR,
-        HTML,
-        I,
-        IFRAME,
-        IMG,
-        INPUT,
-        INS,
-        KBD,
-        LABEL,
-        LEGEND,
-        LI,
-        LINK,
-        MAIN,
-        MAP,
-        MARK,
-        META,
-        METER,
-        NAV,
-        NOFRAMES,
-        NOSCRIPT,
-        OBJECT,
-        OL,
-        OPTGROUP,
-        OPTION,
-        OUTPUT,
-        P,
-        PARAM,
-        PICTURE,
-        PRE,
-        PROGRESS,
-        Q,
-        RP,
-        RT,
-        RUBY,
-        S,
-        SAMP,
-        SCRIPT,
-        SECTION,
-        SELECT,
-        SMALL,
-        SOURCE,
-        SPAN,
-        STRIKE,
-        STRONG,
-        STYLE,
-        SUB,
-        SUMMARY,
-        SUP,
-        SVG,
-        TABLE,
-        TBODY,
-        TD,
-        TEMPLATE,
-        TEXTAREA,
-        TFOOT,
-        TH,
-        THEAD,
-        TIME,
-        TITLE,
-        TR,
-        TRACK,
-        TT,
-        U,
-        UL,
-        VAR,
-        VIDEO,
-        WBR
-    };
+    // Serialized fragments stored back to back in one arena. Fragments are kept as offsets so the batch can be
+    // moved freely; views are handed out on access and stay valid as long as the batch is alive and unchanged.
+    class FragmentBatch {
+        struct Span {
+            size_t offset;
+            size_t length;
+        };
+
+        std::string arena_;
+        std::vector<Span> spans_;
 
-    inline std::string toString(const HtmlTag val) {
-        return StringUtils::toLowerCase(rfl::enum_to_string(val));
-    }
+    public:
+        [[nodiscard]] size_t size() const {
+            return spans_.size();
+        }
+
+        [[nodiscard]] bool empty() const {
+            return spans_.empty();
+        }
+
+        [[nodiscard]] std::string_view operator[](const size_t index) const {
+            return std::string_view(arena_).substr(spans_[index].offset, spans_[index].length);
+        }
+
+        [[nodiscard]] const std::string &getArena() const {
+            return arena_;
+        }
+
+        void reserve(const size_t fragments, const size_t bytes) {
+            spans_.reserve(fragments);
+            arena_.reserve(bytes);
+        }
+
+        // Appends one fragment; produce() receives the arena and appends the fragment's bytes to it.
+        template<typename Producer>
+        void add(Producer &&produce) {
+            const size_t offset = arena_.size();
+            produce(arena_);
+            spans_.push_back({offset, arena_.size() - offset});
+        }
+
+        // Appends all fragments of another batch with a single copy of its arena.
+        void append(FragmentBatch &&other) {
+            const size_t base = arena_.size();
+            arena_.append(other.arena_);
+            spans_.reserve(spans_.size() + other.spans_.size());
+            for (const Span &span: other.spans_) {
+                spans_.push_back({base + span.offset, span.length});
+            }
+            other = {};
+        }
+    };
 
     class HtmlUtility {
     public:
@@ -150,18 +97,41 @@ namespace groklab {
             kStartsWith,
             kEndsWith
         };
+
+        // kPretty indents the tree for reading; kCompact is the plain serialization, which is smaller and faster.
+        enum class SerializeMode {
+            kPretty,
+            kCompact
+        };
+
+        // Called with each chunk right after it has been fed to the parser; returning false ends the parse
+        // there, leaving a document that holds everything parsed so far.
+        using ChunkCallback = std::function<bool(std::string_view chunk)>;
+
+        struct StreamOptions {
+            size_t chunkSize{64 * 1024};
+            ChunkCallback onChunk{};
+        };
+
     private:
         lxb_status_t status_{};
-        lxb_html_parser_t *parser_{};
         lxb_html_document_t *document_{};
         const std::string rootAppElementName_ = {"q-app"};
         lxb_dom_collection_t *rootElementCollection_{};
-        std::map<std::string, lxb_tag_id_t> tagIdMap_{};
+        size_t parsedBytes_{0};
+        bool stoppedEarly_{false};
+        // Length of the last toString() result per SerializeMode, used to size the next one.
+        mutable std::array<std::atomic<size_t>, 2> lastOutputSize_{};
 
     public:
-        explicit HtmlUtility(const std::filesystem::path& filePath) {
-            const std::string htmlContent = FileUtils::readFileAsString(filePath);
-            initialize(htmlContent);
+        // Files are memory-mapped and streamed through the chunked parser, so no copy of the input is held.
+        explicit HtmlUtility(const std::filesystem::path& filePath) : HtmlUtility(filePath, StreamOptions{}) {
+        }
+
+        HtmlUtility(const std::filesystem::path& filePath, const StreamOptions& options) {
+            const MappedFile file(filePath);
+            file.adviseSequential();
+            initializeStreaming(file.view(), options);
         }
 
         explicit HtmlUtility(const std::string& htmlContent) {
@@ -171,7 +141,10 @@ namespace groklab {
         ~HtmlUtility() {
             cleanDomCollection(rootElementCollection_);
             lxb_html_document_destroy(document_);
-            lxb_html_parser_destroy(parser_);
+        }
+
+        [[nodiscard]] lxb_html_document_t* getDocument() const {
+            return document_;
         }
 
         [[nodiscard]] std::string getTitle() const {
@@ -187,23 +160,132 @@ namespace groklab {
             }
         }
 
+        // Number of input bytes fed to the parser; less than the input size if a chunk callback stopped early.
+        [[nodiscard]] size_t getParsedBytes() const {
+            return parsedBytes_;
+        }
+
+        [[nodiscard]] bool isStoppedEarly() const {
+            return stoppedEarly_;
+        }
+
+        // Chunk callback that ends the parse once an opening tag with the given name has been fed. The match is
+        // case-insensitive and carries over chunk boundaries.
+        static ChunkCallback stopAfterTag(const std::string& tagName) {
+            return [needle = "<" + StringUtils::toLowerCase(tagName), matched = size_t{0}](const std::string_view chunk) mutable {
+                for (const char c: chunk) {
+                    if (matched == needle.size()) {
+                        if (c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+                            return false;
+                        }
+                        matched = 0;
+                    }
+                    const char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                    // '<' only occurs at the start of the needle, so a mismatch never skips a partial match.
+                    matched = lower == needle[matched] ? matched + 1 : lower == '<' ? 1 : 0;
+                }
+                return true;
+            };
+        }
+
         void initRootAppElement() {
             rootElementCollection_ = findElementsWithTagName(rootAppElementName_);
         }
 
-        void writeToFile(const std::filesystem::path& filePath) const {
-            const std::string htmlContent = toString();
-            FileUtils::writeToFile(filePath, htmlContent);
+        // Streams the document straight into the file; no serialized copy of the document is built.
+        void writeToFile(const std::filesystem::path& filePath, const SerializeMode mode = SerializeMode::kPretty) const {
+#ifdef _WIN32
+            const int fd = ::_open(filePath.string().c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+            const int fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+            if (fd < 0) {
+                const std::string msg = std::format("Could not open file: {}", filePath.string());
+                error("{}", msg);
+                throw std::runtime_error(msg);
+            }
+            const bool written = writeToFd(fd, mode);
+#ifdef _WIN32
+            ::_close(fd);
+#else
+            ::close(fd);
+#endif
+            if (!written) {
+                const std::string msg = std::format("Could not write file: {}", filePath.string());
+                error("{}", msg);
+                throw std::runtime_error(msg);
+            }
+        }
+
+        // Writes the serialized document to an open file descriptor, batching the serializer's small chunks.
+        bool writeToFd(const int fd, const SerializeMode mode = SerializeMode::kPretty) const {
+            FdSink sink(fd);
+            return serialize(sink, mode) && sink.flush();
         }
 
-        [[nodiscard]] std::string toString() const {
+        [[nodiscard]] std::string toString(const SerializeMode mode = SerializeMode::kPretty) const {
             std::string result;
-            const lxb_status_t status = lxb_html_serialize_pretty_tree_cb(lxb_dom_interface_node(document_),
-                                                       LXB_HTML_SERIALIZE_OPT_UNDEF,
-                                                       0, serializer_callback, &result);
-            if (status != LXB_STATUS_OK) {
+            result.reserve(estimatedSize(mode));
+            if (!serialize([&result](const std::string_view chunk) { result.append(chunk); }, mode)) {
                 critical("Failed to serialize HTML tree");
             }
+            lastOutputSize_[static_cast<size_t>(mode)].store(result.size(), std::memory_order_relaxed);
+            return result;
+        }
+
+        // Cheap guess of the serialized length: the previous output of this mode, else the parsed input plus room
+        // for pretty printing's indentation. The string still grows if the guess is short.
+        [[nodiscard]] size_t estimatedSize(const SerializeMode mode = SerializeMode::kPretty) const {
+            if (const size_t last = lastOutputSize_[static_cast<size_t>(mode)].load(std::memory_order_relaxed);
+                last != 0) {
+                return last;
+            }
+            return mode == SerializeMode::kCompact ? parsedBytes_ : parsedBytes_ + parsedBytes_ / 4;
+        }
+
+        // Exact length of the serialized document, counted without storing it. Costs a full serialization, so
+        // toString() sizes its buffer with estimatedSize() instead.
+        [[nodiscard]] size_t serializedSize(const SerializeMode mode = SerializeMode::kPretty) const {
+            size_t size = 0;
+            serialize([&size](const std::string_view chunk) { size += chunk.size(); }, mode);
+            return size;
+        }
+
+        // Passes the serialized document to sink(std::string_view) chunk by chunk as lexbor produces it. A sink
+        // returning bool aborts the serialization by returning false.
+        template<typename Sink>
+        bool serialize(Sink &&sink, const SerializeMode mode = SerializeMode::kPretty) const {
+            return serializeNode(lxb_dom_interface_node(document_), sink, mode);
+        }
+
+        template<typename Sink>
+        static bool serializeNode(lxb_dom_node_t *node, Sink &&sink, const SerializeMode mode) {
+            const lxb_html_serialize_cb_f callback = [](const lxb_char_t *data, const size_t len, void *ctx) -> lxb_status_t {
+                auto &target = *static_cast<std::remove_reference_t<Sink> *>(ctx);
+                const std::string_view chunk(reinterpret_cast<const char*>(data), len);
+                if constexpr (std::is_same_v<std::invoke_result_t<Sink &, std::string_view>, bool>) {
+                    return target(chunk) ? LXB_STATUS_OK : LXB_STATUS_ERROR;
+                } else {
+                    target(chunk);
+                    return LXB_STATUS_OK;
+                }
+            };
+            const lxb_status_t status = mode == SerializeMode::kCompact
+                                            ? lxb_html_serialize_tree_cb(node, callback, &sink)
+                                            : lxb_html_serialize_pretty_tree_cb(node, LXB_HTML_SERIALIZE_OPT_UNDEF,
+                                                                                0, callback, &sink);
+            return status == LXB_STATUS_OK;
+        }
+
+        // Serializes the children of <body>, i.e. the markup of a parsed fragment without the implied wrapper.
+        [[nodiscard]] std::string bodyContentToString() const {
+            std::string result;
+            const lxb_status_t status = lxb_html_serialize_pretty_deep_cb(lxb_dom_interface_node(document_->body),
+                                                                          LXB_HTML_SERIALIZE_OPT_UNDEF,
+                                                                          0, serializer_callback, &result);
+            if (status != LXB_STATUS_OK) {
+                error("Failed to serialize HTML body");
+            }
             return result;
         }
 
@@ -217,6 +299,16 @@ namespace groklab {
             return result;
         }
 
+        // Markup of the node itself and its descendants, without pretty printing.
+        static std::string nodeToCompactString(lxb_dom_node_t *node) {
+            std::string result;
+            if (!serializeNode(node, [&result](const std::string_view chunk) { result.append(chunk); },
+                               SerializeMode::kCompact)) {
+                error("Failed to serialize HTML node");
+            }
+            return result;
+        }
+
         static void cleanDomCollection(lxb_dom_collection_t *collection) {
             lxb_dom_collection_clean(collection);
         }
@@ -239,7 +331,8 @@ namespace groklab {
 
         static std::vector<std::string> lxbCollectionToString(lxb_dom_collection_t *collection) {
             const auto collectionSize = lxb_dom_collection_length(collection);
-            std::vector<std::string> result(collectionSize);
+            std::vector<std::string> result;
+            result.reserve(collectionSize);
             for (size_t i = 0; i < collectionSize; i++) {
                 lxb_dom_element_t *element = lxb_dom_collection_element(collection, i);
                 result.emplace_back(nodeToString(lxb_dom_interface_node(element)));
@@ -247,6 +340,41 @@ namespace groklab {
             return result;
         }
 
+        // Serializes every element of the collection (with its descendants) into one arena. With a pool, runs
+        // of grainSize elements are serialized as parallel tasks into their own batches, which are joined in
+        // collection order afterwards. Serializing only reads the tree, but the document must not be modified
+        // while a batch is being built.
+        static FragmentBatch serializeCollection(lxb_dom_collection_t *collection,
+                                                 const SerializeMode mode = SerializeMode::kCompact,
+                                                 ThreadPool *pool = nullptr, const size_t grainSize = 512) {
+            const size_t count = lxb_dom_collection_length(collection);
+            const size_t grain = std::max<size_t>(1, grainSize);
+            if (pool == nullptr || count <= grain) {
+                return serializeRange(collection, 0, count, mode);
+            }
+
+            std::vector<FragmentBatch> chunks((count + grain - 1) / grain);
+            TaskGroup group(*pool);
+            for (size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+                group.run([&chunks, collection, chunk, grain, count, mode] {
+                    const size_t begin = chunk * grain;
+                    chunks[chunk] = serializeRange(collection, begin, std::min(begin + grain, count), mode);
+                });
+            }
+            group.wait();
+
+            size_t bytes = 0;
+            for (const auto &chunk: chunks) {
+                bytes += chunk.getArena().size();
+            }
+            FragmentBatch result;
+            result.reserve(count, bytes);
+            for (auto &chunk: chunks) {
+                result.append(std::move(chunk));
+            }
+            return result;
+        }
+
         [[nodiscard]] lxb_dom_collection_t* findElementsByAttribute(const std::string& attributeName,
                                                       const std::string& attributeValue,
                                                       const AttributeMatchType matchType,
@@ -298,35 +426,223 @@ namespace groklab {
             return collection;
         }
 
-        [[nodiscard]] lxb_tag_id_t tagNameToId(const std::string& tagName) const {
-            if (const auto it = tagIdMap_.find(tagName); it != tagIdMap_.end()) {
-                return it->second;
+        // First element in document order matching the CSS selector, or nullptr. Selectors are compiled once per
+        // thread and cached by their text, and the search stops at the first match.
+        [[nodiscard]] lxb_dom_element_t* querySelector(const std::string_view selector) const {
+            return querySelector(lxb_dom_interface_node(document_), selector);
+        }
+
+        [[nodiscard]] static lxb_dom_element_t* querySelector(lxb_dom_node_t *root, const std::string_view selector) {
+            lxb_dom_element_t *match = nullptr;
+            CssSelectorCache::forThread().find(root, selector, [&match](lxb_dom_node_t *node) {
+                match = lxb_dom_interface_element(node);
+                return false;
+            });
+            return match;
+        }
+
+        // All elements matching the CSS selector, in document order. The matches are written into results, which
+        // callers running many queries can keep and pass again so no allocation happens once it has grown.
+        std::span<lxb_dom_element_t* const> querySelectorAll(const std::string_view selector,
+                                                             std::vector<lxb_dom_element_t*>& results) const {
+            return querySelectorAll(lxb_dom_interface_node(document_), selector, results);
+        }
+
+        static std::span<lxb_dom_element_t* const> querySelectorAll(lxb_dom_node_t *root,
+                                                                    const std::string_view selector,
+                                                                    std::vector<lxb_dom_element_t*>& results) {
+            results.clear();
+            CssSelectorCache::forThread().find(root, selector, [&results](lxb_dom_node_t *node) {
+                lxb_dom_element_t *element = lxb_dom_interface_element(node);
+                // A node matching several selectors of a list is reported once per selector.
+                if (results.empty() || results.back() != element) {
+                    results.push_back(element);
+                }
+                return true;
+            });
+            return results;
+        }
+
+        [[nodiscard]] std::vector<lxb_dom_element_t*> querySelectorAll(const std::string_view selector) const {
+            std::vector<lxb_dom_element_t*> results;
+            querySelectorAll(selector, results);
+            return results;
+        }
+
+        [[nodiscard]] lxb_tag_id_t tagNameToId(const std::string_view tagName) const {
+            if (const auto tag = htmlTagFromName(tagName)) {
+                return toLxbTagId(*tag);
             }
-            return LXB_TAG__UNDEF;
+            // Names outside HtmlTag (custom elements such as q-app, SVG and MathML) are looked up in the
+            // document's tag hash, which also holds the names lexbor registered while parsing.
+            return lxb_tag_id_by_name(lxb_html_document_tags(document_),
+                                      reinterpret_cast<const lxb_char_t*>(tagName.data()), tagName.size());
+        }
+
+        // Lexbor id of a known tag. Resolved once per process; lookups afterwards are an array read.
+        static lxb_tag_id_t toLxbTagId(const HtmlTag tag) {
+            static const std::array<lxb_tag_id_t, kHtmlTagNames.size()> ids = [] {
+                std::array<lxb_tag_id_t, kHtmlTagNames.size()> result{};
+                result.fill(LXB_TAG__UNDEF);
+                for (lxb_tag_id_t tagId = LXB_TAG_A; tagId < LXB_TAG__LAST_ENTRY; tagId++) {
+                    if (const auto known = fromLxbTagId(tagId)) {
+                        result[static_cast<size_t>(*known)] = tagId;
+                    }
+                }
+                return result;
+            }();
+            return ids[static_cast<size_t>(tag)];
+        }
+
+        static std::optional<HtmlTag> fromLxbTagId(const lxb_tag_id_t tagId) {
+            size_t tagNameLength{};
+            const lxb_char_t *tagName = lxb_tag_name_by_id(tagId, &tagNameLength);
+            if (tagName == nullptr) {
+                return std::nullopt;
+            }
+            return htmlTagFromName({reinterpret_cast<const char*>(tagName), tagNameLength});
         }
 
     private:
-        void initiateAllDocumentTags() {
-            for (lxb_tag_id_t tag_id = LXB_TAG_A; tag_id < LXB_TAG__LAST_ENTRY; tag_id++) {
-                size_t tag_name_len{};
-                const lxb_char_t *tag_name = lxb_tag_name_by_id(tag_id, &tag_name_len);
-                tagIdMap_[reinterpret_cast<const char*>(tag_name)] = tag_id;
+        static FragmentBatch serializeRange(lxb_dom_collection_t *collection, const size_t begin, const size_t end,
+                                            const SerializeMode mode) {
+            FragmentBatch batch;
+            for (size_t i = begin; i < end; ++i) {
+                lxb_dom_node_t *node = lxb_dom_interface_node(lxb_dom_collection_element(collection, i));
+                batch.add([node, mode](std::string &arena) {
+                    if (!serializeNode(node, [&arena](const std::string_view chunk) { arena.append(chunk); }, mode)) {
+                        error("Failed to serialize HTML node");
+                    }
+                });
             }
+            return batch;
+        }
+
+        // Collects serializer chunks, which are often only a few bytes long, and writes them in large blocks.
+        class FdSink {
+            static constexpr size_t kBufferSize = 64 * 1024;
+
+            int fd_;
+            std::string buffer_;
+
+        public:
+            explicit FdSink(const int fd) : fd_(fd) {
+                buffer_.reserve(kBufferSize);
+            }
+
+            bool operator()(const std::string_view chunk) {
+                if (buffer_.size() + chunk.size() > kBufferSize && !flush()) {
+                    return false;
+                }
+                if (chunk.size() >= kBufferSize) {
+                    return writeAll(chunk);
+                }
+                buffer_.append(chunk);
+                return true;
+            }
+
+            bool flush() {
+                const bool written = writeAll(buffer_);
+                buffer_.clear();
+                return written;
+            }
+
+        private:
+            [[nodiscard]] bool writeAll(std::string_view data) const {
+                while (!data.empty()) {
+#ifdef _WIN32
+                    const int written = ::_write(fd_, data.data(), static_cast<unsigned>(std::min<size_t>(data.size(), INT_MAX)));
+#else
+                    const ssize_t written = ::write(fd_, data.data(), data.size());
+#endif
+                    if (written < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        error("Failed to write serialized HTML: {}", std::strerror(errno));
+                        return false;
+                    }
+                    data.remove_prefix(static_cast<size_t>(written));
+                }
+                return true;
+            }
+        };
+
+        // One parser per thread, reused for every document parsed on it. Documents do not keep a reference to
+        // the parser that built them, so they may outlive the parse and be handed to other threads.
+        static lxb_html_parser_t *threadParser() {
+            struct ThreadParser {
+                lxb_html_parser_t *parser{lxb_html_parser_create()};
+
+                ThreadParser() {
+                    if (lxb_html_parser_init(parser) != LXB_STATUS_OK) {
+                        critical("Failed to create parser!");
+                        parser = lxb_html_parser_destroy(parser);
+                    }
+                }
+
+                ~ThreadParser() {
+                    lxb_html_parser_destroy(parser);
+                }
+            };
+            thread_local ThreadParser threadParser;
+            return threadParser.parser;
         }
 
         void initialize(const std::string& htmlContent) {
-            /* Initialization */
-            parser_ = lxb_html_parser_create();
-            status_ = lxb_html_parser_init(parser_);
-            if (status_ != LXB_STATUS_OK) {
-                critical("Failed to create parser!");
+            lxb_html_parser_t *parser = threadParser();
+            if (parser == nullptr) {
+                status_ = LXB_STATUS_ERROR_OBJECT_IS_NULL;
+                critical("Failed to create Document object");
+                return;
             }
 
-            document_ = lxb_html_parse(parser_, reinterpret_cast<const lxb_char_t *>(htmlContent.c_str()), htmlContent.length());
+            document_ = lxb_html_parse(parser, reinterpret_cast<const lxb_char_t *>(htmlContent.c_str()), htmlContent.length());
+            status_ = lxb_html_parser_status(parser);
+            parsedBytes_ = htmlContent.size();
+            // Drop the tokenizer and tree builder state now rather than holding it until the next parse.
+            lxb_html_parser_clean(parser);
             if (document_ == nullptr) {
                 critical("Failed to create Document object");
             }
-            initiateAllDocumentTags();
+        }
+
+        void initializeStreaming(const std::string_view html, const StreamOptions& options) {
+            lxb_html_parser_t *parser = threadParser();
+            if (parser == nullptr) {
+                status_ = LXB_STATUS_ERROR_OBJECT_IS_NULL;
+                critical("Failed to create Document object");
+                return;
+            }
+
+            document_ = lxb_html_parse_chunk_begin(parser);
+            if (document_ == nullptr) {
+                status_ = lxb_html_parser_status(parser);
+                lxb_html_parser_clean(parser);
+                critical("Failed to create Document object");
+                return;
+            }
+
+            const size_t chunkSize = std::max<size_t>(1, options.chunkSize);
+            status_ = LXB_STATUS_OK;
+            while (parsedBytes_ < html.size() && status_ == LXB_STATUS_OK) {
+                const std::string_view chunk = html.substr(parsedBytes_, chunkSize);
+                status_ = lxb_html_parse_chunk_process(parser, reinterpret_cast<const lxb_char_t *>(chunk.data()),
+                                                       chunk.size());
+                parsedBytes_ += chunk.size();
+                if (options.onChunk && !options.onChunk(chunk)) {
+                    stoppedEarly_ = parsedBytes_ < html.size();
+                    break;
+                }
+            }
+            // Ending the parse closes every element still open, so an early stop leaves a well-formed document.
+            if (const lxb_status_t status = lxb_html_parse_chunk_end(parser); status_ == LXB_STATUS_OK) {
+                status_ = status;
+            }
+            lxb_html_parser_clean(parser);
+            if (status_ != LXB_STATUS_OK) {
+                error("Failed to parse HTML stream after {} bytes", parsedBytes_);
+            }
         }
 
         static lxb_status_t serializer_callback(const lxb_char_t *data, const size_t len, void *ctx) {
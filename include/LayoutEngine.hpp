@@ -0,0 +1,470 @@
+#pragma once
+
+#ifndef LAYOUTENGINE_HPP
+#define LAYOUTENGINE_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "ScreenUtils.hpp"
+#include "WidgetStore.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace groklab {
+    // Reductions over contiguous float arrays, four lanes at a time where SSE2 or NEON is available.
+    namespace LayoutMath {
+        inline float sum(const float *values, const size_t count) {
+            size_t i = 0;
+            float total = 0.0f;
+#if defined(__SSE2__) || defined(_M_X64)
+            __m128 lanes = _mm_setzero_ps();
+            for (; i + 4 <= count; i += 4) {
+                lanes = _mm_add_ps(lanes, _mm_loadu_ps(values + i));
+            }
+            alignas(16) float parts[4];
+            _mm_store_ps(parts, lanes);
+            total = (parts[0] + parts[1]) + (parts[2] + parts[3]);
+#elif defined(__ARM_NEON)
+            float32x4_t lanes = vdupq_n_f32(0.0f);
+            for (; i + 4 <= count; i += 4) {
+                lanes = vaddq_f32(lanes, vld1q_f32(values + i));
+            }
+            total = vaddvq_f32(lanes);
+#endif
+            for (; i < count; ++i) {
+                total += values[i];
+            }
+            return total;
+        }
+
+        // Largest value, 0 for an empty array; sizes are never negative.
+        inline float max(const float *values, const size_t count) {
+            size_t i = 0;
+            float result = 0.0f;
+#if defined(__SSE2__) || defined(_M_X64)
+            __m128 lanes = _mm_setzero_ps();
+            for (; i + 4 <= count; i += 4) {
+                lanes = _mm_max_ps(lanes, _mm_loadu_ps(values + i));
+            }
+            alignas(16) float parts[4];
+            _mm_store_ps(parts, lanes);
+            result = std::max(std::max(parts[0], parts[1]), std::max(parts[2], parts[3]));
+#elif defined(__ARM_NEON)
+            float32x4_t lanes = vdupq_n_f32(0.0f);
+            for (; i + 4 <= count; i += 4) {
+                lanes = vmaxq_f32(lanes, vld1q_f32(values + i));
+            }
+            result = vmaxvq_f32(lanes);
+#endif
+            for (; i < count; ++i) {
+                result = std::max(result, values[i]);
+            }
+            return result;
+        }
+    }
+
+    // Subset of flexbox a layout widget supports: one main axis, fixed or content sizes, grow factors, padding,
+    // gap and cross-axis alignment. Sizes below zero mean "size to content".
+    struct LayoutStyle {
+        enum class Align : uint8_t {
+            kStretch,
+            kStart,
+            kCenter,
+            kEnd,
+        };
+
+        static constexpr float kAuto = -1.0f;
+
+        Widget::LayoutType direction{Widget::LayoutType::Vertical};
+        float width{kAuto};
+        float height{kAuto};
+        // Share of the parent's free main-axis space, as flex-grow.
+        float grow{0.0f};
+        float padding{0.0f};
+        // Space between children along the main axis.
+        float gap{0.0f};
+        // Placement of children across the main axis.
+        Align align{Align::kStretch};
+    };
+
+    // Computes widget boxes for a WidgetStore in two passes: a bottom-up measure pass, which gives every widget
+    // its content size, and a top-down arrange pass, which hands out the space of each layout to its children.
+    // Styles, measurements and results are kept per widget in parallel arrays indexed by WidgetId.
+    //
+    // Both passes are cached. markDirty() flags a widget and its ancestors; the next layout() measures only
+    // flagged widgets and arranges only flagged widgets and those whose box changed, so changing one leaf costs
+    // its ancestors plus the siblings that move, not the whole tree. Hidden widgets take no space.
+    class LayoutEngine {
+    public:
+        // Content size of a widget without children, e.g. text. The default estimates text from the "text"
+        // attribute with a fixed character width and line height.
+        using Measure = std::function<std::pair<float, float>(const WidgetStore &store, WidgetId widget)>;
+
+        static constexpr float kCharWidth = 8.0f;
+        static constexpr float kLineHeight = 20.0f;
+
+    private:
+        enum Dirty : uint8_t {
+            kClean = 0,
+            kMeasure = 1,
+            kArrange = 2,
+        };
+
+        const WidgetStore &store_;
+        Measure measure_;
+
+        // Style.
+        std::vector<Widget::LayoutType> directions_;
+        std::vector<LayoutStyle::Align> aligns_;
+        std::vector<float> fixedWidths_;
+        std::vector<float> fixedHeights_;
+        std::vector<float> grows_;
+        std::vector<float> paddings_;
+        std::vector<float> gaps_;
+        // Measure pass.
+        std::vector<float> measuredWidths_;
+        std::vector<float> measuredHeights_;
+        std::vector<uint8_t> dirty_;
+        // Arrange pass.
+        std::vector<float> xs_;
+        std::vector<float> ys_;
+        std::vector<float> widths_;
+        std::vector<float> heights_;
+
+        // Children of the layout being processed, gathered so the sums run over contiguous memory.
+        std::vector<WidgetId> childIds_;
+        std::vector<float> childMain_;
+        std::vector<float> childCross_;
+        std::vector<float> childGrow_;
+
+        size_t measuredCount_{0};
+        size_t arrangedCount_{0};
+
+    public:
+        explicit LayoutEngine(const WidgetStore &store) : store_(store), measure_(measureText) {
+        }
+
+        LayoutEngine(const LayoutEngine &) = delete;
+        LayoutEngine &operator=(const LayoutEngine &) = delete;
+
+        void setMeasure(Measure measure) {
+            measure_ = measure ? std::move(measure) : Measure(measureText);
+            std::fill(dirty_.begin(), dirty_.end(), kMeasure | kArrange);
+        }
+
+        void setStyle(const WidgetId widget, const LayoutStyle &style) {
+            sync();
+            directions_[widget] = style.direction;
+            aligns_[widget] = style.align;
+            fixedWidths_[widget] = style.width;
+            fixedHeights_[widget] = style.height;
+            grows_[widget] = style.grow;
+            paddings_[widget] = style.padding;
+            gaps_[widget] = style.gap;
+            markDirty(widget);
+        }
+
+        [[nodiscard]] LayoutStyle getStyle(const WidgetId widget) {
+            sync();
+            return {directions_[widget], fixedWidths_[widget], fixedHeights_[widget], grows_[widget],
+                    paddings_[widget], gaps_[widget], aligns_[widget]};
+        }
+
+        // Reads a style from the widget's attributes: layout ("horizontal" or "vertical"), width, height, grow,
+        // padding, gap and align ("stretch", "start", "center" or "end"). Missing attributes keep the default.
+        void loadStyle(const WidgetId widget) {
+            LayoutStyle style;
+            if (store_.getAttribute(widget, "layout") == "horizontal") {
+                style.direction = Widget::LayoutType::Horizontal;
+            }
+            style.width = parseNumber(store_.getAttribute(widget, "width"), LayoutStyle::kAuto);
+            style.height = parseNumber(store_.getAttribute(widget, "height"), LayoutStyle::kAuto);
+            style.grow = parseNumber(store_.getAttribute(widget, "grow"), 0.0f);
+            style.padding = parseNumber(store_.getAttribute(widget, "padding"), 0.0f);
+            style.gap = parseNumber(store_.getAttribute(widget, "gap"), 0.0f);
+            const std::string_view align = store_.getAttribute(widget, "align");
+            if (align == "start") {
+                style.align = LayoutStyle::Align::kStart;
+            } else if (align == "center") {
+                style.align = LayoutStyle::Align::kCenter;
+            } else if (align == "end") {
+                style.align = LayoutStyle::Align::kEnd;
+            }
+            setStyle(widget, style);
+        }
+
+        // Forgets all styles and boxes, e.g. after the store was cleared or restored.
+        void reset() {
+            for (auto *table: {&fixedWidths_, &fixedHeights_, &grows_, &paddings_, &gaps_, &measuredWidths_,
+                               &measuredHeights_, &xs_, &ys_, &widths_, &heights_}) {
+                table->clear();
+            }
+            directions_.clear();
+            aligns_.clear();
+            dirty_.clear();
+        }
+
+        // Flags a widget whose content, style or visibility changed, and its ancestors.
+        void markDirty(WidgetId widget) {
+            sync();
+            while (widget != kNoWidget && dirty_[widget] != (kMeasure | kArrange)) {
+                dirty_[widget] = kMeasure | kArrange;
+                widget = store_.getParent(widget);
+            }
+        }
+
+        // Lays out the tree under root in a viewport of the given size; root fills the viewport.
+        void layout(const WidgetId root, const ScreenSize viewport) {
+            sync();
+            measuredCount_ = arrangedCount_ = 0;
+            if (root >= store_.size()) {
+                return;
+            }
+            measure(root);
+            arrange(root, static_cast<float>(viewport.width), static_cast<float>(viewport.height));
+        }
+
+        [[nodiscard]] ScreenRect getRect(const WidgetId widget) const {
+            if (widget >= xs_.size()) {
+                return {};
+            }
+            const int x = static_cast<int>(std::lround(xs_[widget]));
+            const int y = static_cast<int>(std::lround(ys_[widget]));
+            return {{x, y}, {static_cast<int>(std::lround(xs_[widget] + widths_[widget])) - x,
+                             static_cast<int>(std::lround(ys_[widget] + heights_[widget])) - y}};
+        }
+
+        [[nodiscard]] Widget::LayoutType getDirection(const WidgetId widget) const {
+            return widget < directions_.size() ? directions_[widget] : Widget::LayoutType::Vertical;
+        }
+
+        // Style as of the last layout(), for readers of a const engine; the default style for widgets added since.
+        [[nodiscard]] LayoutStyle getLayoutStyle(const WidgetId widget) const {
+            if (widget >= directions_.size()) {
+                return {};
+            }
+            return {directions_[widget], fixedWidths_[widget], fixedHeights_[widget], grows_[widget],
+                    paddings_[widget], gaps_[widget], aligns_[widget]};
+        }
+
+        // Widgets measured and arranged by the last layout(), to check how much work a change caused.
+        [[nodiscard]] size_t getMeasuredCount() const {
+            return measuredCount_;
+        }
+
+        [[nodiscard]] size_t getArrangedCount() const {
+            return arrangedCount_;
+        }
+
+        static std::pair<float, float> measureText(const WidgetStore &store, const WidgetId widget) {
+            const std::string_view text = store.getAttribute(widget, "text");
+            return {static_cast<float>(text.size()) * kCharWidth, text.empty() ? 0.0f : kLineHeight};
+        }
+
+    private:
+        // Extends the arrays to widgets added to the store since the last call; new widgets start dirty.
+        void sync() {
+            const size_t count = store_.size();
+            if (dirty_.size() >= count) {
+                return;
+            }
+            const size_t first = dirty_.size();
+            for (size_t widget = first; widget < count; ++widget) {
+                directions_.push_back(Widget::LayoutType::Vertical);
+                aligns_.push_back(LayoutStyle::Align::kStretch);
+                fixedWidths_.push_back(LayoutStyle::kAuto);
+                fixedHeights_.push_back(LayoutStyle::kAuto);
+                grows_.push_back(0.0f);
+                paddings_.push_back(0.0f);
+                gaps_.push_back(0.0f);
+                measuredWidths_.push_back(0.0f);
+                measuredHeights_.push_back(0.0f);
+                dirty_.push_back(kMeasure | kArrange);
+                xs_.push_back(0.0f);
+                ys_.push_back(0.0f);
+                widths_.push_back(0.0f);
+                heights_.push_back(0.0f);
+            }
+            // A new child dirties its ancestors; a new parent's own walk covers the ones above it.
+            for (size_t widget = first; widget < count; ++widget) {
+                for (WidgetId parent = store_.getParent(static_cast<WidgetId>(widget));
+                     parent != kNoWidget && dirty_[parent] != (kMeasure | kArrange);
+                     parent = store_.getParent(parent)) {
+                    dirty_[parent] = kMeasure | kArrange;
+                }
+            }
+        }
+
+        static float parseNumber(const std::string_view text, const float fallback) {
+            float value = fallback;
+            if (!text.empty()) {
+                std::from_chars(text.data(), text.data() + text.size(), value);
+            }
+            return value;
+        }
+
+        [[nodiscard]] bool isHorizontal(const WidgetId widget) const {
+            return directions_[widget] == Widget::LayoutType::Horizontal;
+        }
+
+        // Gathers the visible children of widget and their measured main and cross sizes.
+        void gatherChildren(const WidgetId widget) {
+            childIds_.clear();
+            childMain_.clear();
+            childCross_.clear();
+            childGrow_.clear();
+            const bool horizontal = isHorizontal(widget);
+            store_.forEachChild(widget, [&](const WidgetId child) {
+                if (!store_.isVisible(child)) {
+                    return;
+                }
+                childIds_.push_back(child);
+                childMain_.push_back(horizontal ? measuredWidths_[child] : measuredHeights_[child]);
+                childCross_.push_back(horizontal ? measuredHeights_[child] : measuredWidths_[child]);
+                childGrow_.push_back(grows_[child]);
+            });
+        }
+
+        // Bottom-up: content size of every dirty widget under root, children before parents.
+        void measure(const WidgetId root) {
+            std::vector<std::pair<WidgetId, bool> > stack{{root, false}};
+            while (!stack.empty()) {
+                auto [widget, expanded] = stack.back();
+                stack.pop_back();
+                if ((dirty_[widget] & kMeasure) == 0) {
+                    continue;
+                }
+                if (!expanded) {
+                    stack.emplace_back(widget, true);
+                    store_.forEachChild(widget, [&](const WidgetId child) { stack.emplace_back(child, false); });
+                    continue;
+                }
+                dirty_[widget] &= ~kMeasure;
+                ++measuredCount_;
+
+                float contentWidth;
+                float contentHeight;
+                if (store_.getFirstChild(widget) == kNoWidget) {
+                    std::tie(contentWidth, contentHeight) = measure_(store_, widget);
+                    contentWidth += 2 * paddings_[widget];
+                    contentHeight += 2 * paddings_[widget];
+                } else {
+                    gatherChildren(widget);
+                    const size_t count = childIds_.size();
+                    const float gaps = count > 1 ? gaps_[widget] * static_cast<float>(count - 1) : 0.0f;
+                    const float main = LayoutMath::sum(childMain_.data(), count) + gaps + 2 * paddings_[widget];
+                    const float cross = LayoutMath::max(childCross_.data(), count) + 2 * paddings_[widget];
+                    contentWidth = isHorizontal(widget) ? main : cross;
+                    contentHeight = isHorizontal(widget) ? cross : main;
+                }
+                measuredWidths_[widget] = fixedWidths_[widget] >= 0 ? fixedWidths_[widget] : contentWidth;
+                measuredHeights_[widget] = fixedHeights_[widget] >= 0 ? fixedHeights_[widget] : contentHeight;
+            }
+        }
+
+        struct Placement {
+            WidgetId widget;
+            float x;
+            float y;
+            float width;
+            float height;
+        };
+
+        // Top-down: positions the children of every widget whose box changed or that is flagged.
+        void arrange(const WidgetId root, const float width, const float height) {
+            std::vector<Placement> stack{{root, 0.0f, 0.0f, width, height}};
+            while (!stack.empty()) {
+                const Placement placement = stack.back();
+                stack.pop_back();
+                const WidgetId widget = placement.widget;
+                const bool moved = xs_[widget] != placement.x || ys_[widget] != placement.y;
+                const bool resized = widths_[widget] != placement.width || heights_[widget] != placement.height;
+                if (!resized && (dirty_[widget] & kArrange) == 0) {
+                    if (moved) {
+                        translate(widget, placement.x - xs_[widget], placement.y - ys_[widget]);
+                    }
+                    continue;
+                }
+                dirty_[widget] &= ~kArrange;
+                ++arrangedCount_;
+                xs_[widget] = placement.x;
+                ys_[widget] = placement.y;
+                widths_[widget] = placement.width;
+                heights_[widget] = placement.height;
+                if (store_.getFirstChild(widget) == kNoWidget) {
+                    continue;
+                }
+
+                gatherChildren(widget);
+                const size_t count = childIds_.size();
+                const bool horizontal = isHorizontal(widget);
+                const float padding = paddings_[widget];
+                const float innerMain = (horizontal ? placement.width : placement.height) - 2 * padding;
+                const float innerCross = (horizontal ? placement.height : placement.width) - 2 * padding;
+                const float gap = gaps_[widget];
+                const float used = LayoutMath::sum(childMain_.data(), count) +
+                                   (count > 1 ? gap * static_cast<float>(count - 1) : 0.0f);
+                const float free = std::max(0.0f, innerMain - used);
+                const float totalGrow = LayoutMath::sum(childGrow_.data(), count);
+                const float perGrow = totalGrow > 0.0f ? free / totalGrow : 0.0f;
+
+                float offset = padding;
+                for (size_t i = 0; i < count; ++i) {
+                    const WidgetId child = childIds_[i];
+                    const float main = childMain_[i] + childGrow_[i] * perGrow;
+                    const float fixedCross = horizontal ? fixedHeights_[child] : fixedWidths_[child];
+                    float cross = childCross_[i];
+                    float crossOffset = padding;
+                    switch (aligns_[widget]) {
+                        case LayoutStyle::Align::kStretch:
+                            cross = fixedCross >= 0 ? fixedCross : std::max(0.0f, innerCross);
+                            break;
+                        case LayoutStyle::Align::kStart:
+                            break;
+                        case LayoutStyle::Align::kCenter:
+                            crossOffset += (innerCross - cross) / 2;
+                            break;
+                        case LayoutStyle::Align::kEnd:
+                            crossOffset += innerCross - cross;
+                            break;
+                    }
+                    if (horizontal) {
+                        stack.push_back({child, placement.x + offset, placement.y + crossOffset, main, cross});
+                    } else {
+                        stack.push_back({child, placement.x + crossOffset, placement.y + offset, cross, main});
+                    }
+                    offset += main + gap;
+                }
+            }
+        }
+
+        // Moves a clean subtree without laying it out again.
+        void translate(const WidgetId root, const float dx, const float dy) {
+            std::vector<WidgetId> stack{root};
+            while (!stack.empty()) {
+                const WidgetId widget = stack.back();
+                stack.pop_back();
+                xs_[widget] += dx;
+                ys_[widget] += dy;
+                store_.forEachChild(widget, [&](const WidgetId child) {
+                    if (store_.isVisible(child)) {
+                        stack.push_back(child);
+                    }
+                });
+            }
+        }
+    };
+}
+
+#endif //LAYOUTENGINE_HPP
@@ -0,0 +1,136 @@
+#pragma once
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "Log.hpp"
+
+#ifdef _WIN32
+#include "FileUtils.hpp"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace groklab {
+    // Read-only view of a whole file. On POSIX systems the file is memory-mapped; elsewhere it falls back to
+    // reading the file into an owned buffer so callers can rely on the same interface.
+    class MappedFile {
+        const char *data_{nullptr};
+        size_t size_{0};
+#ifdef _WIN32
+        std::string buffer_;
+#endif
+
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(const std::filesystem::path &filePath) {
+#ifdef _WIN32
+            buffer_ = FileUtils::readFileAsString(filePath.string());
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+#else
+            const int fd = ::open(filePath.c_str(), O_RDONLY);
+            if (fd < 0) {
+                const std::string msg = std::format("Could not open file: {}", filePath.string());
+                error("{}", msg);
+                throw std::runtime_error(msg);
+            }
+            struct stat fileStat{};
+            if (::fstat(fd, &fileStat) != 0) {
+                ::close(fd);
+                const std::string msg = std::format("Could not stat file: {}", filePath.string());
+                error("{}", msg);
+                throw std::runtime_error(msg);
+            }
+            size_ = static_cast<size_t>(fileStat.st_size);
+            if (size_ > 0) {
+                void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    ::close(fd);
+                    const std::string msg = std::format("Could not map file: {}", filePath.string());
+                    error("{}", msg);
+                    throw std::runtime_error(msg);
+                }
+                data_ = static_cast<const char *>(mapping);
+            }
+            ::close(fd);
+#endif
+        }
+
+        ~MappedFile() {
+            release();
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        MappedFile(MappedFile &&other) noexcept {
+            *this = std::move(other);
+        }
+
+        MappedFile &operator=(MappedFile &&other) noexcept {
+            if (this != &other) {
+                release();
+#ifdef _WIN32
+                buffer_ = std::move(other.buffer_);
+                data_ = buffer_.data();
+#else
+                data_ = other.data_;
+#endif
+                size_ = other.size_;
+                other.data_ = nullptr;
+                other.size_ = 0;
+            }
+            return *this;
+        }
+
+        [[nodiscard]] const char *data() const {
+            return data_;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return size_;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return size_ == 0;
+        }
+
+        [[nodiscard]] std::string_view view() const {
+            return {data_, size_};
+        }
+
+        // Hints the kernel that the mapping will be read front to back, e.g. for chunked parsing.
+        void adviseSequential() const {
+#ifndef _WIN32
+            if (data_ != nullptr) {
+                ::madvise(const_cast<char *>(data_), size_, MADV_SEQUENTIAL);
+            }
+#endif
+        }
+
+    private:
+        void release() {
+#ifdef _WIN32
+            buffer_.clear();
+#else
+            if (data_ != nullptr) {
+                ::munmap(const_cast<char *>(data_), size_);
+            }
+#endif
+            data_ = nullptr;
+            size_ = 0;
+        }
+    };
+}
+
+#endif //MAPPEDFILE_HPP
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef PROPSCHEMA_HPP
+#define PROPSCHEMA_HPP
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <rfl.hpp>
+#include <rfl/json.hpp>
+
+namespace groklab {
+    // Props of a component without any inputs.
+    struct NoProps {
+    };
+
+    template<typename T>
+    struct IsVector : std::false_type {
+    };
+
+    template<typename T, typename Alloc>
+    struct IsVector<std::vector<T, Alloc> > : std::true_type {
+    };
+
+    // Maps a C++ prop type onto the constructor Vue expects in a `props:` declaration.
+    template<typename T>
+    constexpr std::string_view vueTypeOf() {
+        using Type = std::remove_cvref_t<T>;
+        if constexpr (std::is_same_v<Type, bool>) {
+            return "Boolean";
+        } else if constexpr (std::is_arithmetic_v<Type>) {
+            return "Number";
+        } else if constexpr (std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view> ||
+                             std::is_enum_v<Type>) {
+            return "String";
+        } else if constexpr (IsVector<Type>::value) {
+            return "Array";
+        } else {
+            return "Object";
+        }
+    }
+
+    // Compile time prop schema of a plain aggregate. Field names and types come from reflect-cpp, so a component
+    // declares its props once as a struct and both typed access and the Vue declaration follow from it.
+    template<typename PropsType>
+    struct PropSchema {
+        static constexpr bool kEmpty = std::is_empty_v<PropsType>;
+
+        [[nodiscard]] static std::vector<std::string> names() {
+            std::vector<std::string> result;
+            if constexpr (!kEmpty) {
+                for (const auto &field: rfl::fields<PropsType>()) {
+                    result.emplace_back(field.name());
+                }
+            }
+            return result;
+        }
+
+        // Generates the `props: { ... }` block, using the values of a default constructed PropsType as defaults.
+        // Non-empty scopes prefix each name with `<scope>_`.
+        [[nodiscard]] static std::string toVueProps(const std::string_view scope = {}) {
+            std::string result = "props: {\n";
+            if constexpr (!kEmpty) {
+                static const PropsType defaults{};
+                rfl::to_view(defaults).apply([&](const auto &field) {
+                    using FieldType = std::remove_cvref_t<decltype(*field.value())>;
+                    result.append("  ");
+                    if (!scope.empty()) {
+                        result.append(scope).append("_");
+                    }
+                    result.append(field.name()).append(": {\n");
+                    result.append("    type: ").append(vueTypeOf<FieldType>()).append(",\n");
+                    result.append("    default: ").append(defaultLiteral(*field.value())).append("\n");
+                    result.append("  },\n");
+                });
+            }
+            result.append("}\n");
+            return result;
+        }
+
+    private:
+        // Vue requires object and array defaults to be factory functions.
+        template<typename T>
+        static std::string defaultLiteral(const T &value) {
+            if constexpr (vueTypeOf<T>() == "Object" || vueTypeOf<T>() == "Array") {
+                return "() => (" + rfl::json::write(value) + ")";
+            } else {
+                return rfl::json::write(value);
+            }
+        }
+    };
+}
+
+#endif //PROPSCHEMA_HPP
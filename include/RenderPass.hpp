@@ -0,0 +1,175 @@
+#pragma once
+
+#ifndef RENDERPASS_HPP
+#define RENDERPASS_HPP
+
+#include <string>
+#include <vector>
+#include "ComponentNode.hpp"
+#include "ThreadPool.hpp"
+
+namespace groklab {
+    enum class RenderMode {
+        Serial,
+        Parallel
+    };
+
+    // Incremental render of a component tree. Only subtrees flagged by ComponentNode::markDirty() are visited,
+    // and every dirty node contributes one JSON patch; the patches of one pass are delivered to the page as a
+    // single script so the update cost follows the size of the change rather than the size of the page.
+    //
+    // In parallel mode, sibling subtrees are rendered as tasks on a work-stealing pool. Each task writes into its
+    // own buffer and the buffers are joined in child order, so the output matches a serial pass byte for byte.
+    // Components must not mark other components dirty from render()/compose() while a parallel pass runs.
+    class RenderPass {
+        struct Output {
+            std::string patches;
+            size_t patchCount{0};
+            size_t visitedCount{0};
+
+            void append(Output &&other) {
+                if (other.patchCount > 0) {
+                    if (patchCount > 0) {
+                        patches.push_back(',');
+                    }
+                    patches.append(other.patches);
+                }
+                patchCount += other.patchCount;
+                visitedCount += other.visitedCount;
+            }
+        };
+
+        RenderMode mode_{RenderMode::Serial};
+        ThreadPool *pool_{nullptr};
+        size_t grainSize_{64};
+        Output output_;
+
+    public:
+        RenderPass() = default;
+
+        RenderPass(const RenderMode mode, ThreadPool *pool) {
+            setMode(mode, pool);
+        }
+
+        // Parallel mode needs a pool; without one the pass silently stays serial.
+        void setMode(const RenderMode mode, ThreadPool *pool = nullptr) {
+            mode_ = pool == nullptr ? RenderMode::Serial : mode;
+            pool_ = pool;
+        }
+
+        [[nodiscard]] RenderMode getMode() const {
+            return mode_;
+        }
+
+        // Number of dirty sibling subtrees rendered by one task in parallel mode.
+        void setGrainSize(const size_t grainSize) {
+            grainSize_ = std::max<size_t>(1, grainSize);
+        }
+
+        void run(ComponentNode &root) {
+            if (!root.isSubtreeDirty() && !root.isDirty()) {
+                return;
+            }
+            Output output;
+            if (mode_ == RenderMode::Parallel) {
+                visitParallel(root, output);
+            } else {
+                visitSerial(root, output);
+            }
+            output_.append(std::move(output));
+        }
+
+        [[nodiscard]] bool empty() const {
+            return output_.patchCount == 0;
+        }
+
+        [[nodiscard]] size_t getPatchCount() const {
+            return output_.patchCount;
+        }
+
+        [[nodiscard]] size_t getVisitedCount() const {
+            return output_.visitedCount;
+        }
+
+        [[nodiscard]] const std::string &getPatches() const {
+            return output_.patches;
+        }
+
+        // Builds the script applying every collected patch and resets the pass for the next frame.
+        [[nodiscard]] std::string takeScript() {
+            std::string script;
+            script.reserve(output_.patches.size() + 64);
+            script.append("window.fluid && window.fluid.applyPatches([").append(output_.patches).append("]);");
+            reset();
+            return script;
+        }
+
+        void reset() {
+            output_ = {};
+        }
+
+    private:
+        static void renderNode(ComponentNode &node, Output &output) {
+            ++output.visitedCount;
+            if (node.takeDirty()) {
+                node.render();
+                if (output.patchCount++ > 0) {
+                    output.patches.push_back(',');
+                }
+                node.appendPatch(output.patches);
+            }
+        }
+
+        static void visitSerial(ComponentNode &node, Output &output) {
+            node.clearSubtreeDirty();
+            renderNode(node, output);
+            for (const auto &child: node.getChildren()) {
+                if (child->isSubtreeDirty()) {
+                    visitSerial(*child, output);
+                }
+            }
+        }
+
+        void visitParallel(ComponentNode &node, Output &output) {
+            node.clearSubtreeDirty();
+            renderNode(node, output);
+
+            std::vector<ComponentNode *> dirtyChildren;
+            for (const auto &child: node.getChildren()) {
+                if (child->isSubtreeDirty()) {
+                    dirtyChildren.push_back(child.get());
+                }
+            }
+
+            if (dirtyChildren.size() <= 1) {
+                for (ComponentNode *child: dirtyChildren) {
+                    visitParallel(*child, output);
+                }
+            } else {
+                // One task per chunk of siblings; each chunk's output is merged back in order after the join.
+                const size_t chunkCount = (dirtyChildren.size() + grainSize_ - 1) / grainSize_;
+                std::vector<Output> chunks(chunkCount);
+                TaskGroup group(*pool_);
+                for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                    group.run([this, &dirtyChildren, &chunks, chunk] {
+                        const size_t begin = chunk * grainSize_;
+                        const size_t end = std::min(begin + grainSize_, dirtyChildren.size());
+                        for (size_t i = begin; i < end; ++i) {
+                            if (dirtyChildren[i]->getChildren().empty()) {
+                                visitSerial(*dirtyChildren[i], chunks[chunk]);
+                            } else {
+                                visitParallel(*dirtyChildren[i], chunks[chunk]);
+                            }
+                        }
+                    });
+                }
+                group.wait();
+                for (auto &chunk: chunks) {
+                    output.append(std::move(chunk));
+                }
+            }
+        }
+    };
+}
+
+#endif //RENDERPASS_HPP
@@ -0,0 +1,212 @@
+#pragma once
+
+#ifndef RPCBINDINGS_HPP
+#define RPCBINDINGS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+#include <rfl.hpp>
+#include <rfl/json.hpp>
+#include "BridgeEncoding.hpp"
+#include "CallbackTable.hpp"
+#include "Log.hpp"
+#include "PropSchema.hpp"
+#include "StringUtils.hpp"
+#include "WebviewBackend.hpp"
+
+namespace groklab {
+    template<typename T>
+    struct IsOptional : std::false_type {
+    };
+
+    template<typename T>
+    struct IsOptional<std::optional<T> > : std::true_type {
+    };
+
+    // JSDoc type of a value as reflect-cpp writes it to JSON. Aggregates expand into record types field by field.
+    template<typename T>
+    std::string jsTypeOf() {
+        using Type = std::remove_cvref_t<T>;
+        if constexpr (std::is_void_v<Type>) {
+            return "null";
+        } else if constexpr (std::is_same_v<Type, bool>) {
+            return "boolean";
+        } else if constexpr (std::is_arithmetic_v<Type>) {
+            return "number";
+        } else if constexpr (std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view> ||
+                             std::is_enum_v<Type>) {
+            return "string";
+        } else if constexpr (IsVector<Type>::value) {
+            return "Array<" + jsTypeOf<typename Type::value_type>() + ">";
+        } else if constexpr (IsOptional<Type>::value) {
+            return "(" + jsTypeOf<typename Type::value_type>() + "|null)";
+        } else if constexpr (std::is_aggregate_v<Type> && std::is_default_constructible_v<Type>) {
+            if constexpr (std::is_empty_v<Type>) {
+                return "{}";
+            } else {
+                static const Type sample{};
+                std::string result = "{";
+                bool first = true;
+                rfl::to_view(sample).apply([&](const auto &field) {
+                    if (!first) {
+                        result.append(", ");
+                    }
+                    first = false;
+                    result.append(field.name()).append(": ");
+                    result.append(jsTypeOf<decltype(*field.value())>());
+                });
+                return result.append("}");
+            }
+        } else {
+            return "*";
+        }
+    }
+
+    // Typed RPC over webview bindings. A handler is a C++ function taking no argument or one request struct and
+    // returning a response struct (or void); reflect-cpp decodes the request straight from the webview's request
+    // buffer and encodes the response. Decoding errors and exceptions reject the page's promise.
+    //
+    // Every binding also gets a typed client stub, window.fluid.rpc.<name>(request), documented with JSDoc types
+    // derived from the structs. Stubs are installed with webview::init for future pages and evaluated right away
+    // for the current one, so the page runtime (runtime.js) must be injected first. Init scripts cannot be removed,
+    // so a name can be bound again only with the same request, response and encoding; its stub stays valid.
+    class RpcBindings {
+        struct Stub {
+            std::string name;
+            std::string script;
+        };
+
+        WebviewBackend &webview_;
+        std::vector<Stub> stubs_;
+        std::unordered_set<std::string> bound_;
+
+    public:
+        explicit RpcBindings(WebviewBackend &webview) : webview_(webview) {
+        }
+
+        RpcBindings(const RpcBindings &) = delete;
+        RpcBindings &operator=(const RpcBindings &) = delete;
+
+        ~RpcBindings() {
+            for (const auto &name: bound_) {
+                webview_.unbind(name);
+            }
+        }
+
+        // Cheap, unique and monotonic ids for requests and responses.
+        [[nodiscard]] static uint64_t nextRequestId() {
+            static std::atomic<uint64_t> next{1};
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Registers func under name. With BridgeEncoding::kCbor the response crosses the bridge as CBOR and the stub
+        // decodes it before resolving. Binding a name again replaces its handler; throws std::invalid_argument if
+        // the new handler would need a different client stub than the one already installed.
+        template<typename Func>
+        void bind(const std::string &name, Func &&func, const BridgeEncoding encoding = BridgeEncoding::kJson) {
+            using Traits = CallableTraits<std::decay_t<Func> >;
+            using Arguments = typename Traits::Arguments;
+            using Result = typename Traits::Result;
+            static_assert(std::tuple_size_v<Arguments> <= 1, "RPC handlers take at most one request struct");
+
+            const BridgeEncoding effective = BridgeCodec::effective(encoding);
+            const std::string script = stubScript<Arguments, Result>(name, effective);
+            const auto stub = std::find_if(stubs_.begin(), stubs_.end(),
+                                           [&](const Stub &existing) { return existing.name == name; });
+            if (stub != stubs_.end() && stub->script != script) {
+                throw std::invalid_argument("RPC '" + name + "' is already bound with a different signature or "
+                                            "encoding, and its installed client stub cannot be replaced");
+            }
+
+            if (bound_.contains(name)) {
+                webview_.unbind(name);
+            }
+            webview_.bind(name, [this, func = std::forward<Func>(func), effective](
+                          const std::string &id, const std::string &request) mutable {
+                try {
+                    if (const auto response = invoke<Arguments, Result>(func, request, effective)) {
+                        webview_.resolve(id, 0, *response);
+                        return;
+                    }
+                    webview_.resolve(id, 1, "\"Invalid request\"");
+                } catch (const std::exception &e) {
+                    std::string message;
+                    StringUtils::appendJsonString(message, e.what());
+                    webview_.resolve(id, 1, message);
+                }
+            });
+            bound_.insert(name);
+
+            if (stub == stubs_.end()) {
+                stubs_.push_back({name, script});
+                webview_.init(script);
+                webview_.eval(script);
+            }
+        }
+
+        // All client stubs in registration order, e.g. to ship them as a static script.
+        [[nodiscard]] std::string getClientScript() const {
+            std::string result;
+            for (const auto &stub: stubs_) {
+                result.append(stub.script);
+            }
+            return result;
+        }
+
+    private:
+        template<typename Arguments, typename Result, typename Func>
+        static std::optional<std::string> invoke(Func &func, const std::string &request,
+                                                 const BridgeEncoding encoding) {
+            Arguments arguments{};
+            if constexpr (std::tuple_size_v<Arguments> > 0) {
+                auto decoded = rfl::json::read<Arguments>(request);
+                if (!decoded) {
+                    error("Failed to decode RPC request {}", request);
+                    return std::nullopt;
+                }
+                arguments = std::move(decoded.value());
+            }
+            if constexpr (std::is_void_v<Result>) {
+                std::apply(func, std::move(arguments));
+                return std::string{"null"};
+            } else {
+                return BridgeCodec::toJson(std::apply(func, std::move(arguments)), encoding);
+            }
+        }
+
+        template<typename Arguments, typename Result>
+        static std::string stubScript(const std::string &name, const BridgeEncoding encoding) {
+            std::string script = "if (window.fluid) {\n    /**\n";
+            if constexpr (std::tuple_size_v<Arguments> > 0) {
+                script.append("     * @param {").append(jsTypeOf<std::tuple_element_t<0, Arguments> >());
+                script.append("} request\n");
+            }
+            script.append("     * @returns {Promise<").append(jsTypeOf<Result>()).append(">}\n     */\n");
+            script.append("    window.fluid.rpc[");
+            StringUtils::appendJsonString(script, name);
+            const std::string_view decode = encoding == BridgeEncoding::kCbor ? ".then(window.fluid.decodeCbor)" : "";
+            if constexpr (std::tuple_size_v<Arguments> > 0) {
+                script.append("] = request => window[");
+                StringUtils::appendJsonString(script, name);
+                script.append("](request)").append(decode).append(";\n}\n");
+            } else {
+                script.append("] = () => window[");
+                StringUtils::appendJsonString(script, name);
+                script.append("]()").append(decode).append(";\n}\n");
+            }
+            return script;
+        }
+    };
+}
+
+#endif //RPCBINDINGS_HPP
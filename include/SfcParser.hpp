@@ -0,0 +1,515 @@
+#pragma once
+
+#ifndef SFCPARSER_HPP
+#define SFCPARSER_HPP
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace groklab {
+    // One top level block of a Vue single file component, e.g. <style scoped lang="scss">...</style>.
+    // All views point into the buffer owned by the SfcDescriptor that produced the block.
+    struct SfcBlock {
+        std::string_view type{};
+        std::string_view attributes{};
+        std::string_view content{};
+        size_t contentOffset{0};
+
+        [[nodiscard]] bool hasAttribute(const std::string_view name) const {
+            return findAttribute(name).found;
+        }
+
+        [[nodiscard]] std::string_view getAttribute(const std::string_view name) const {
+            return findAttribute(name).value;
+        }
+
+        [[nodiscard]] bool isScoped() const {
+            return hasAttribute("scoped");
+        }
+
+        [[nodiscard]] bool isSetup() const {
+            return hasAttribute("setup");
+        }
+
+        [[nodiscard]] std::string_view getLang() const {
+            return getAttribute("lang");
+        }
+
+    private:
+        struct AttributeLookup {
+            bool found{false};
+            std::string_view value{};
+        };
+
+        [[nodiscard]] AttributeLookup findAttribute(const std::string_view name) const {
+            size_t pos = 0;
+            const size_t size = attributes.size();
+            while (pos < size) {
+                while (pos < size && isSpace(attributes[pos])) {
+                    ++pos;
+                }
+                const size_t nameBegin = pos;
+                while (pos < size && !isSpace(attributes[pos]) && attributes[pos] != '=' && attributes[pos] != '/') {
+                    ++pos;
+                }
+                const std::string_view attributeName = attributes.substr(nameBegin, pos - nameBegin);
+                while (pos < size && isSpace(attributes[pos])) {
+                    ++pos;
+                }
+
+                std::string_view value{};
+                if (pos < size && attributes[pos] == '=') {
+                    ++pos;
+                    while (pos < size && isSpace(attributes[pos])) {
+                        ++pos;
+                    }
+                    if (pos < size && (attributes[pos] == '"' || attributes[pos] == '\'')) {
+                        const char quote = attributes[pos++];
+                        const size_t valueBegin = pos;
+                        while (pos < size && attributes[pos] != quote) {
+                            ++pos;
+                        }
+                        value = attributes.substr(valueBegin, pos - valueBegin);
+                        ++pos;
+                    } else {
+                        const size_t valueBegin = pos;
+                        while (pos < size && !isSpace(attributes[pos])) {
+                            ++pos;
+                        }
+                        value = attributes.substr(valueBegin, pos - valueBegin);
+                    }
+                }
+
+                if (!attributeName.empty() && equalsIgnoreCase(attributeName, name)) {
+                    return {true, value};
+                }
+                if (attributeName.empty()) {
+                    ++pos;
+                }
+            }
+            return {};
+        }
+
+    public:
+        static bool isSpace(const char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+        }
+
+        static char toLower(const char c) {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        static bool equalsIgnoreCase(const std::string_view lhs, const std::string_view rhs) {
+            return lhs.size() == rhs.size() &&
+                   std::equal(lhs.begin(), lhs.end(), rhs.begin(),
+                              [](const char a, const char b) { return toLower(a) == toLower(b); });
+        }
+    };
+
+    // Single pass, allocation light scanner for Vue single file components. The descriptor owns one copy of the
+    // source and every block it exposes is a view into that buffer, so no section is ever copied out.
+    class SfcDescriptor {
+        // Held through a pointer so that moving the descriptor never invalidates the block views.
+        std::unique_ptr<const std::string> source_;
+        std::vector<SfcBlock> blocks_;
+
+    public:
+        SfcDescriptor() : source_(std::make_unique<const std::string>()) {
+        }
+
+        explicit SfcDescriptor(std::string source) : source_(std::make_unique<const std::string>(std::move(source))) {
+            scan();
+        }
+
+        SfcDescriptor(const SfcDescriptor &) = delete;
+        SfcDescriptor &operator=(const SfcDescriptor &) = delete;
+        SfcDescriptor(SfcDescriptor &&) noexcept = default;
+        SfcDescriptor &operator=(SfcDescriptor &&) noexcept = default;
+
+        [[nodiscard]] std::string_view getSource() const {
+            return *source_;
+        }
+
+        [[nodiscard]] const std::vector<SfcBlock> &getBlocks() const {
+            return blocks_;
+        }
+
+        [[nodiscard]] const SfcBlock *findBlock(const std::string_view type) const {
+            for (const auto &block: blocks_) {
+                if (SfcBlock::equalsIgnoreCase(block.type, type)) {
+                    return &block;
+                }
+            }
+            return nullptr;
+        }
+
+        [[nodiscard]] std::vector<const SfcBlock *> findBlocks(const std::string_view type) const {
+            std::vector<const SfcBlock *> result;
+            for (const auto &block: blocks_) {
+                if (SfcBlock::equalsIgnoreCase(block.type, type)) {
+                    result.push_back(&block);
+                }
+            }
+            return result;
+        }
+
+        [[nodiscard]] std::string_view getTemplateContent() const {
+            const SfcBlock *block = findBlock("template");
+            return block == nullptr ? std::string_view{} : block->content;
+        }
+
+        // Prefers the classic <script> block over <script setup> since the former carries `export default`.
+        [[nodiscard]] std::string_view getScriptContent() const {
+            const SfcBlock *fallback = nullptr;
+            for (const auto &block: blocks_) {
+                if (SfcBlock::equalsIgnoreCase(block.type, "script")) {
+                    if (!block.isSetup()) {
+                        return block.content;
+                    }
+                    if (fallback == nullptr) {
+                        fallback = &block;
+                    }
+                }
+            }
+            return fallback == nullptr ? std::string_view{} : fallback->content;
+        }
+
+        [[nodiscard]] std::vector<const SfcBlock *> getStyleBlocks() const {
+            return findBlocks("style");
+        }
+
+        // Returns the body of `export default { ... }`, matching braces while skipping strings and comments.
+        static std::string_view exportDefaultBody(const std::string_view script) {
+            constexpr std::string_view exportKeyword = "export";
+            constexpr std::string_view defaultKeyword = "default";
+            size_t pos = 0;
+            while ((pos = script.find(exportKeyword, pos)) != std::string_view::npos) {
+                size_t cursor = skipSpaces(script, pos + exportKeyword.size());
+                if (cursor == pos + exportKeyword.size() || script.substr(cursor, defaultKeyword.size()) != defaultKeyword) {
+                    pos += exportKeyword.size();
+                    continue;
+                }
+                cursor = skipSpaces(script, cursor + defaultKeyword.size());
+                if (cursor >= script.size() || script[cursor] != '{') {
+                    return {};
+                }
+                const size_t bodyBegin = cursor + 1;
+                const size_t bodyEnd = findMatchingBrace(script, cursor);
+                if (bodyEnd == std::string_view::npos) {
+                    return {};
+                }
+                return script.substr(bodyBegin, bodyEnd - bodyBegin);
+            }
+            return {};
+        }
+
+        // Extracts prop names from an `export default` body, supporting both `props: ['a', 'b']` and
+        // `props: { a: {...}, b: String }`. The returned views point into `exportBody`.
+        static std::vector<std::string_view> propNames(const std::string_view exportBody) {
+            std::vector<std::string_view> names;
+            size_t propsValue = std::string_view::npos;
+            forEachObjectKey(exportBody, [&](const std::string_view key, const size_t valuePos) {
+                if (key == "props" && propsValue == std::string_view::npos) {
+                    propsValue = valuePos;
+                }
+            });
+            if (propsValue == std::string_view::npos || propsValue >= exportBody.size()) {
+                return names;
+            }
+
+            const char open = exportBody[propsValue];
+            if (open == '{') {
+                const size_t end = findMatchingBrace(exportBody, propsValue);
+                const std::string_view props = exportBody.substr(propsValue + 1,
+                                                                 end == std::string_view::npos
+                                                                     ? std::string_view::npos
+                                                                     : end - propsValue - 1);
+                forEachObjectKey(props, [&](const std::string_view key, size_t) {
+                    names.push_back(key);
+                });
+            } else if (open == '[') {
+                for (size_t pos = propsValue + 1; pos < exportBody.size() && exportBody[pos] != ']'; ++pos) {
+                    const char c = exportBody[pos];
+                    if (c == '"' || c == '\'' || c == '`') {
+                        const size_t end = skipString(exportBody, pos);
+                        names.push_back(exportBody.substr(pos + 1, end - pos - 2));
+                        pos = end - 1;
+                    }
+                }
+            }
+            return names;
+        }
+
+    private:
+        void scan() {
+            const std::string_view src = *source_;
+            const size_t size = src.size();
+            size_t pos = 0;
+            while (pos < size) {
+                pos = src.find('<', pos);
+                if (pos == std::string_view::npos) {
+                    break;
+                }
+                if (src.compare(pos, 4, "<!--") == 0) {
+                    const size_t end = src.find("-->", pos + 4);
+                    pos = end == std::string_view::npos ? size : end + 3;
+                    continue;
+                }
+                if (pos + 1 >= size || !isTagNameStart(src[pos + 1])) {
+                    ++pos;
+                    continue;
+                }
+
+                const size_t nameBegin = pos + 1;
+                size_t cursor = nameBegin;
+                while (cursor < size && isTagNameChar(src[cursor])) {
+                    ++cursor;
+                }
+                const std::string_view type = src.substr(nameBegin, cursor - nameBegin);
+
+                const size_t openEnd = findTagEnd(src, cursor);
+                if (openEnd == std::string_view::npos) {
+                    break;
+                }
+                size_t attributesEnd = openEnd;
+                const bool selfClosing = openEnd > cursor && src[openEnd - 1] == '/';
+                if (selfClosing) {
+                    --attributesEnd;
+                }
+
+                SfcBlock block;
+                block.type = type;
+                block.attributes = src.substr(cursor, attributesEnd - cursor);
+                block.contentOffset = openEnd + 1;
+
+                if (selfClosing) {
+                    block.content = src.substr(openEnd + 1, 0);
+                    blocks_.push_back(block);
+                    pos = openEnd + 1;
+                    continue;
+                }
+
+                const bool rawText = SfcBlock::equalsIgnoreCase(type, "script") ||
+                                     SfcBlock::equalsIgnoreCase(type, "style");
+                const auto [closeBegin, closeEnd] = rawText
+                                                        ? findRawClose(src, type, openEnd + 1)
+                                                        : findNestedClose(src, type, openEnd + 1);
+                if (closeBegin == std::string_view::npos) {
+                    block.content = src.substr(openEnd + 1);
+                    blocks_.push_back(block);
+                    break;
+                }
+                block.content = src.substr(openEnd + 1, closeBegin - openEnd - 1);
+                blocks_.push_back(block);
+                pos = closeEnd;
+            }
+        }
+
+        static bool isTagNameStart(const char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        static bool isTagNameChar(const char c) {
+            return isTagNameStart(c) || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == ':';
+        }
+
+        static size_t skipSpaces(const std::string_view src, size_t pos) {
+            while (pos < src.size() && SfcBlock::isSpace(src[pos])) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // Finds the '>' closing an opening tag, ignoring any '>' inside quoted attribute values.
+        static size_t findTagEnd(const std::string_view src, size_t pos) {
+            char quote = 0;
+            for (; pos < src.size(); ++pos) {
+                const char c = src[pos];
+                if (quote != 0) {
+                    if (c == quote) {
+                        quote = 0;
+                    }
+                } else if (c == '"' || c == '\'') {
+                    quote = c;
+                } else if (c == '>') {
+                    return pos;
+                }
+            }
+            return std::string_view::npos;
+        }
+
+        // Checks for `</type` at pos followed by whitespace or '>' and returns the position past the closing '>'.
+        static size_t matchCloseTag(const std::string_view src, const std::string_view type, const size_t pos) {
+            if (pos + 2 + type.size() > src.size() || src[pos] != '<' || src[pos + 1] != '/') {
+                return std::string_view::npos;
+            }
+            if (!SfcBlock::equalsIgnoreCase(src.substr(pos + 2, type.size()), type)) {
+                return std::string_view::npos;
+            }
+            const size_t after = pos + 2 + type.size();
+            if (after < src.size() && isTagNameChar(src[after])) {
+                return std::string_view::npos;
+            }
+            const size_t end = src.find('>', after);
+            return end == std::string_view::npos ? std::string_view::npos : end + 1;
+        }
+
+        static std::pair<size_t, size_t> findRawClose(const std::string_view src, const std::string_view type,
+                                                      size_t pos) {
+            while ((pos = src.find("</", pos)) != std::string_view::npos) {
+                if (const size_t end = matchCloseTag(src, type, pos); end != std::string_view::npos) {
+                    return {pos, end};
+                }
+                pos += 2;
+            }
+            return {std::string_view::npos, std::string_view::npos};
+        }
+
+        // Template blocks may contain nested <template v-if> elements, so track the nesting depth of the same tag.
+        static std::pair<size_t, size_t> findNestedClose(const std::string_view src, const std::string_view type,
+                                                         size_t pos) {
+            size_t depth = 1;
+            while ((pos = src.find('<', pos)) != std::string_view::npos) {
+                if (src.compare(pos, 4, "<!--") == 0) {
+                    const size_t end = src.find("-->", pos + 4);
+                    if (end == std::string_view::npos) {
+                        break;
+                    }
+                    pos = end + 3;
+                    continue;
+                }
+                if (const size_t end = matchCloseTag(src, type, pos); end != std::string_view::npos) {
+                    if (--depth == 0) {
+                        return {pos, end};
+                    }
+                    pos = end;
+                    continue;
+                }
+                const size_t nameBegin = pos + 1;
+                if (nameBegin + type.size() <= src.size() &&
+                    SfcBlock::equalsIgnoreCase(src.substr(nameBegin, type.size()), type) &&
+                    (nameBegin + type.size() == src.size() || !isTagNameChar(src[nameBegin + type.size()]))) {
+                    const size_t openEnd = findTagEnd(src, nameBegin + type.size());
+                    if (openEnd == std::string_view::npos) {
+                        break;
+                    }
+                    if (src[openEnd - 1] != '/') {
+                        ++depth;
+                    }
+                    pos = openEnd + 1;
+                    continue;
+                }
+                ++pos;
+            }
+            return {std::string_view::npos, std::string_view::npos};
+        }
+
+        // Returns the position just past the closing quote of the string literal starting at pos.
+        static size_t skipString(const std::string_view src, size_t pos) {
+            const char quote = src[pos];
+            for (++pos; pos < src.size() && src[pos] != quote; ++pos) {
+                if (src[pos] == '\\') {
+                    ++pos;
+                }
+            }
+            return std::min(pos + 1, src.size());
+        }
+
+        // Returns the position just past a // or /* */ comment starting at pos, or pos if there is none.
+        static size_t skipComment(const std::string_view src, const size_t pos) {
+            if (src[pos] != '/' || pos + 1 >= src.size()) {
+                return pos;
+            }
+            if (src[pos + 1] == '/') {
+                const size_t end = src.find('\n', pos);
+                return end == std::string_view::npos ? src.size() : end + 1;
+            }
+            if (src[pos + 1] == '*') {
+                const size_t end = src.find("*/", pos + 2);
+                return end == std::string_view::npos ? src.size() : end + 2;
+            }
+            return pos;
+        }
+
+        static bool isIdentifierChar(const char c) {
+            return isTagNameStart(c) || (c >= '0' && c <= '9') || c == '_' || c == '$';
+        }
+
+        // Calls func(key, valuePos) for every key of a JS object literal body, skipping nested values.
+        template<typename Func>
+        static void forEachObjectKey(const std::string_view body, Func &&func) {
+            size_t depth = 0;
+            bool expectKey = true;
+            size_t pos = 0;
+            while (pos < body.size()) {
+                const char c = body[pos];
+                if (const size_t end = skipComment(body, pos); end != pos) {
+                    pos = end;
+                    continue;
+                }
+                if (c == '"' || c == '\'' || c == '`') {
+                    const size_t end = skipString(body, pos);
+                    if (depth == 0 && expectKey) {
+                        const size_t colon = skipSpaces(body, end);
+                        if (colon < body.size() && body[colon] == ':') {
+                            func(body.substr(pos + 1, end - pos - 2), skipSpaces(body, colon + 1));
+                        }
+                        expectKey = false;
+                    }
+                    pos = end;
+                    continue;
+                }
+                if (depth == 0 && expectKey && isIdentifierChar(c)) {
+                    size_t end = pos;
+                    while (end < body.size() && isIdentifierChar(body[end])) {
+                        ++end;
+                    }
+                    const size_t colon = skipSpaces(body, end);
+                    if (colon < body.size() && body[colon] == ':') {
+                        func(body.substr(pos, end - pos), skipSpaces(body, colon + 1));
+                    }
+                    expectKey = false;
+                    pos = end;
+                    continue;
+                }
+                if (c == '{' || c == '[' || c == '(') {
+                    ++depth;
+                } else if ((c == '}' || c == ']' || c == ')') && depth > 0) {
+                    --depth;
+                } else if (c == ',' && depth == 0) {
+                    expectKey = true;
+                }
+                ++pos;
+            }
+        }
+
+        static size_t findMatchingBrace(const std::string_view src, size_t pos) {
+            size_t depth = 0;
+            while (pos < src.size()) {
+                const char c = src[pos];
+                if (c == '"' || c == '\'' || c == '`') {
+                    pos = skipString(src, pos);
+                    continue;
+                }
+                if (const size_t end = skipComment(src, pos); end != pos) {
+                    pos = end;
+                    continue;
+                }
+                if (c == '{') {
+                    ++depth;
+                } else if (c == '}') {
+                    if (--depth == 0) {
+                        return pos;
+                    }
+                }
+                ++pos;
+            }
+            return std::string_view::npos;
+        }
+    };
+}
+
+#endif //SFCPARSER_HPP
@@ -0,0 +1,339 @@
+#pragma once
+
+#ifndef STREAMBINDINGS_HPP
+#define STREAMBINDINGS_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <rfl.hpp>
+#include <rfl/json.hpp>
+#include "AsyncBindings.hpp"
+#include "Log.hpp"
+#include "StringUtils.hpp"
+#include "ThreadPool.hpp"
+#include "WebviewBackend.hpp"
+
+namespace groklab {
+    // Declared outside StreamBindings so it can be defaulted in its member function signatures.
+    struct StreamBindingOptions {
+        // A chunk is sealed once its JSON reaches this size; a single larger item makes a chunk on its own.
+        size_t chunkBytes{256 * 1024};
+        // Sealed chunks waiting for the page. The producer blocks while this many are buffered, so a stream never
+        // holds more than (maxBufferedChunks + 1) chunks no matter how fast it produces or how slow the page is.
+        size_t maxBufferedChunks{2};
+    };
+
+    // Streaming bindings: a producer runs on a worker thread and writes items, which are serialized into bounded
+    // JSON array chunks while the page consumes the previous ones. The page pulls one chunk at a time with
+    //
+    //     for await (const rows of window.fluid.stream("report", [args])) { ... }
+    //
+    // and only asks for the next chunk once the loop body is done with the last, so time to first row and peak
+    // memory stay bounded by the chunk settings rather than by the size of the result. Leaving the loop early, a
+    // hidden page or cancelAll() stop the producer through its stop_token.
+    class StreamBindings {
+    public:
+        using Options = StreamBindingOptions;
+
+        static constexpr auto kPullBinding = "__fluid_pull";
+        static constexpr auto kCancelBinding = "__fluid_stream_cancel";
+
+    private:
+        struct Stream {
+            std::string token;
+            Options options;
+            std::stop_source stop;
+            std::mutex mutex;
+            std::condition_variable_any space;
+            std::deque<std::string> ready;
+            // Webview request id of a pull that arrived before the next chunk was ready.
+            std::optional<std::string> pendingPull;
+            bool finished{false};
+            std::optional<std::string> failure;
+        };
+
+    public:
+        // Handed to producers. write() blocks while the page is behind and returns false once the stream is
+        // cancelled, at which point the producer should return.
+        class Writer {
+            StreamBindings &owner_;
+            Stream &stream_;
+            std::string chunk_;
+
+        public:
+            Writer(StreamBindings &owner, Stream &stream) : owner_(owner), stream_(stream) {
+            }
+
+            template<typename T>
+            bool write(const T &item) {
+                return writeJson(rfl::json::write(item));
+            }
+
+            bool writeJson(const std::string_view json) {
+                if (isCancelled()) {
+                    return false;
+                }
+                if (chunk_.empty()) {
+                    chunk_.reserve(stream_.options.chunkBytes + json.size() + 2);
+                    chunk_.push_back('[');
+                } else {
+                    chunk_.push_back(',');
+                }
+                chunk_.append(json);
+                if (chunk_.size() >= stream_.options.chunkBytes) {
+                    return flush();
+                }
+                return true;
+            }
+
+            // Seals the current chunk early, e.g. to show the first rows sooner.
+            bool flush() {
+                if (chunk_.empty()) {
+                    return !isCancelled();
+                }
+                chunk_.push_back(']');
+                return owner_.deliver(stream_, std::exchange(chunk_, {}));
+            }
+
+            [[nodiscard]] bool isCancelled() const {
+                return stream_.stop.stop_requested();
+            }
+
+            [[nodiscard]] std::stop_token getStopToken() const {
+                return stream_.stop.get_token();
+            }
+        };
+
+        // Receives the JSON array of arguments passed to window.fluid.stream() and writes the items.
+        using Producer = std::function<void(const std::string &arguments, Writer &writer)>;
+
+    private:
+        WebviewBackend &webview_;
+        std::mutex mutex_;
+        std::unordered_map<std::string, std::pair<Producer, Options> > bindings_;
+        std::unordered_map<std::string, std::shared_ptr<Stream> > streams_;
+        // Declared last: destroyed first, so every producer has finished before the state above goes away.
+        ThreadPool pool_;
+
+    public:
+        // threadCount bounds the number of producers running at once; further streams wait for a free worker.
+        explicit StreamBindings(WebviewBackend &webview,
+                                const size_t threadCount = std::max(1u, std::thread::hardware_concurrency() / 2))
+            : webview_(webview), pool_(threadCount) {
+            webview_.bind(kPullBinding, [this](const std::string &id, const std::string &request) {
+                pull(id, TaggedRequest::parse(request).token);
+            });
+            webview_.bind(kCancelBinding, [this](const std::string &request) -> std::string {
+                const std::string token = TaggedRequest::parse(request).token;
+                if (token == "*") {
+                    cancelAll();
+                } else {
+                    cancel(token);
+                }
+                return "null";
+            });
+        }
+
+        StreamBindings(const StreamBindings &) = delete;
+        StreamBindings &operator=(const StreamBindings &) = delete;
+
+        ~StreamBindings() {
+            cancelAll();
+            std::lock_guard lock(mutex_);
+            for (const auto &[name, binding]: bindings_) {
+                webview_.unbind(name);
+            }
+            webview_.unbind(kPullBinding);
+            webview_.unbind(kCancelBinding);
+        }
+
+        void bind(const std::string &name, Producer producer, const Options options = {}) {
+            {
+                std::lock_guard lock(mutex_);
+                Options checked = options;
+                checked.chunkBytes = std::max<size_t>(1, options.chunkBytes);
+                checked.maxBufferedChunks = std::max<size_t>(1, options.maxBufferedChunks);
+                bindings_[name] = {std::move(producer), checked};
+            }
+            webview_.bind(name, [this, name](const std::string &request) -> std::string {
+                open(name, request);
+                return "null";
+            });
+        }
+
+        void cancel(const std::string &token) {
+            std::shared_ptr<Stream> stream;
+            {
+                std::lock_guard lock(mutex_);
+                const auto it = streams_.find(token);
+                if (it == streams_.end()) {
+                    return;
+                }
+                stream = it->second;
+                streams_.erase(it);
+            }
+            stop(*stream);
+        }
+
+        void cancelAll() {
+            std::unordered_map<std::string, std::shared_ptr<Stream> > streams;
+            {
+                std::lock_guard lock(mutex_);
+                streams.swap(streams_);
+            }
+            for (const auto &[token, stream]: streams) {
+                stop(*stream);
+            }
+        }
+
+        [[nodiscard]] size_t getOpenCount() {
+            std::lock_guard lock(mutex_);
+            return streams_.size();
+        }
+
+    private:
+        void open(const std::string &name, const std::string &request) {
+            TaggedRequest tagged = TaggedRequest::parse(request);
+            if (tagged.token.empty()) {
+                error("Stream '{}' opened without stream token; use window.fluid.stream()", name);
+                return;
+            }
+            auto stream = std::make_shared<Stream>();
+            stream->token = tagged.token;
+
+            std::lock_guard lock(mutex_);
+            const auto it = bindings_.find(name);
+            if (it == bindings_.end()) {
+                stream->finished = true;
+                stream->failure = "Unknown stream " + name;
+                streams_[stream->token] = std::move(stream);
+                return;
+            }
+            stream->options = it->second.second;
+            streams_[stream->token] = stream;
+            pool_.submit([this, producer = it->second.first, stream, arguments = std::move(tagged.arguments)] {
+                Writer writer(*this, *stream);
+                std::optional<std::string> failure;
+                try {
+                    if (!stream->stop.stop_requested()) {
+                        producer(arguments, writer);
+                        writer.flush();
+                    }
+                } catch (const std::exception &e) {
+                    failure = e.what();
+                } catch (...) {
+                    failure = "Unknown error";
+                }
+                finish(*stream, std::move(failure));
+            });
+        }
+
+        // Producer side: hands a sealed chunk to a waiting pull, or buffers it, blocking while the buffer is full.
+        bool deliver(Stream &stream, std::string chunk) {
+            std::optional<std::string> pullId;
+            {
+                std::unique_lock lock(stream.mutex);
+                if (!stream.pendingPull) {
+                    const bool hasSpace = stream.space.wait(lock, stream.stop.get_token(), [&] {
+                        return stream.ready.size() < stream.options.maxBufferedChunks || stream.pendingPull;
+                    });
+                    if (!hasSpace) {
+                        return false;
+                    }
+                }
+                if (stream.pendingPull) {
+                    pullId = std::exchange(stream.pendingPull, std::nullopt);
+                } else {
+                    stream.ready.push_back(std::move(chunk));
+                    return true;
+                }
+            }
+            webview_.resolve(*pullId, 0, chunk);
+            return true;
+        }
+
+        // Producer side: marks the end of the stream and answers a pull that is already waiting for it.
+        void finish(Stream &stream, std::optional<std::string> failure) {
+            std::optional<std::string> pullId;
+            {
+                std::lock_guard lock(stream.mutex);
+                stream.finished = true;
+                stream.failure = std::move(failure);
+                if (stream.ready.empty()) {
+                    pullId = std::exchange(stream.pendingPull, std::nullopt);
+                }
+            }
+            if (pullId) {
+                settleEnd(stream, *pullId);
+            }
+        }
+
+        // UI thread: answers with the next chunk, null at the end, or parks the pull until a chunk is ready.
+        void pull(const std::string &id, const std::string &token) {
+            std::shared_ptr<Stream> stream;
+            {
+                std::lock_guard lock(mutex_);
+                if (const auto it = streams_.find(token); it != streams_.end()) {
+                    stream = it->second;
+                }
+            }
+            if (stream == nullptr) {
+                webview_.resolve(id, 1, "\"Unknown or cancelled stream\"");
+                return;
+            }
+
+            std::string chunk;
+            {
+                std::lock_guard lock(stream->mutex);
+                if (!stream->ready.empty()) {
+                    chunk = std::move(stream->ready.front());
+                    stream->ready.pop_front();
+                } else if (!stream->finished) {
+                    stream->pendingPull = id;
+                    stream->space.notify_one();
+                    return;
+                }
+            }
+            if (chunk.empty()) {
+                settleEnd(*stream, id);
+                return;
+            }
+            stream->space.notify_one();
+            webview_.resolve(id, 0, chunk);
+        }
+
+        void settleEnd(Stream &stream, const std::string &id) {
+            {
+                std::lock_guard lock(mutex_);
+                streams_.erase(stream.token);
+            }
+            if (stream.failure) {
+                std::string message;
+                StringUtils::appendJsonString(message, *stream.failure);
+                webview_.resolve(id, 1, message);
+            } else {
+                webview_.resolve(id, 0, "null");
+            }
+        }
+
+        static void stop(Stream &stream) {
+            stream.stop.request_stop();
+            std::lock_guard lock(stream.mutex);
+            stream.ready.clear();
+        }
+    };
+}
+
+#endif //STREAMBINDINGS_HPP
@@ -5,7 +5,9 @@
 #define STRINGUTILS_HPP
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <iostream>
 namespace groklab {
     struct StringUtils {
@@ -14,6 +16,75 @@ namespace groklab {
             std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return std::tolower(c); });
             return result;
         }
+
+        // 64-bit FNV-1a, used wherever a cheap, stable content hash is enough.
+        static constexpr uint64_t hash(const std::string_view str, uint64_t seed = 14695981039346656037ull) {
+            for (const char c: str) {
+                seed ^= static_cast<unsigned char>(c);
+                seed *= 1099511628211ull;
+            }
+            return seed;
+        }
+
+        // Appends str as a quoted JSON string literal. "</" is written as "<\/" so the result can be embedded
+        // in an inline <script> as well.
+        static void appendJsonString(std::string &out, const std::string_view str) {
+            static constexpr char kHex[] = "0123456789abcdef";
+            out.push_back('"');
+            for (size_t i = 0; i < str.size(); ++i) {
+                const char c = str[i];
+                switch (c) {
+                    case '"': out.append("\\\""); break;
+                    case '\\': out.append("\\\\"); break;
+                    case '\n': out.append("\\n"); break;
+                    case '\r': out.append("\\r"); break;
+                    case '\t': out.append("\\t"); break;
+                    case '/':
+                        if (i > 0 && str[i - 1] == '<') {
+                            out.push_back('\\');
+                        }
+                        out.push_back('/');
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            out.append("\\u00");
+                            out.push_back(kHex[(c >> 4) & 0xF]);
+                            out.push_back(kHex[c & 0xF]);
+                        } else {
+                            out.push_back(c);
+                        }
+                }
+            }
+            out.push_back('"');
+        }
+
+        // Appends bytes as standard, padded base64.
+        static void appendBase64(std::string &out, const std::string_view bytes) {
+            static constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            const size_t start = out.size();
+            out.resize(start + (bytes.size() + 2) / 3 * 4);
+            char *dest = out.data() + start;
+            size_t i = 0;
+            for (; i + 3 <= bytes.size(); i += 3) {
+                const uint32_t triple = static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << 16 |
+                                        static_cast<uint32_t>(static_cast<unsigned char>(bytes[i + 1])) << 8 |
+                                        static_cast<unsigned char>(bytes[i + 2]);
+                *dest++ = kAlphabet[triple >> 18 & 0x3F];
+                *dest++ = kAlphabet[triple >> 12 & 0x3F];
+                *dest++ = kAlphabet[triple >> 6 & 0x3F];
+                *dest++ = kAlphabet[triple & 0x3F];
+            }
+            if (const size_t rest = bytes.size() - i; rest > 0) {
+                uint32_t triple = static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << 16;
+                if (rest == 2) {
+                    triple |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i + 1])) << 8;
+                }
+                *dest++ = kAlphabet[triple >> 18 & 0x3F];
+                *dest++ = kAlphabet[triple >> 12 & 0x3F];
+                *dest++ = rest == 2 ? kAlphabet[triple >> 6 & 0x3F] : '=';
+                *dest++ = '=';
+            }
+        }
     };
 }
 #endif //STRINGUTILS_HPP
@@ -0,0 +1,219 @@
+#pragma once
+
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace groklab {
+    // Work-stealing thread pool. Every worker owns a deque: it pushes and pops its own work at the back (LIFO,
+    // cache friendly for fork-join recursion) while idle workers steal from the front of other deques.
+    class ThreadPool {
+    public:
+        using Task = std::function<void()>;
+
+    private:
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkQueue> > queues_;
+        std::vector<std::thread> threads_;
+        std::atomic<bool> stopping_{false};
+        std::atomic<size_t> pending_{0};
+        std::atomic<size_t> nextQueue_{0};
+        std::mutex sleepMutex_;
+        std::condition_variable wake_;
+
+        static ThreadPool *&currentPool() {
+            thread_local ThreadPool *pool = nullptr;
+            return pool;
+        }
+
+        static size_t &currentIndex() {
+            thread_local size_t index = 0;
+            return index;
+        }
+
+    public:
+        explicit ThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+            threadCount = std::max<size_t>(1, threadCount);
+            queues_.reserve(threadCount);
+            for (size_t i = 0; i < threadCount; ++i) {
+                queues_.emplace_back(std::make_unique<WorkQueue>());
+            }
+            threads_.reserve(threadCount);
+            for (size_t i = 0; i < threadCount; ++i) {
+                threads_.emplace_back([this, i] { workerLoop(i); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(sleepMutex_);
+                stopping_.store(true);
+            }
+            wake_.notify_all();
+            for (auto &thread: threads_) {
+                thread.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        [[nodiscard]] size_t size() const {
+            return threads_.size();
+        }
+
+        // True when called from one of this pool's workers.
+        [[nodiscard]] bool isWorkerThread() const {
+            return currentPool() == this;
+        }
+
+        void submit(Task task) {
+            const size_t index = isWorkerThread()
+                                     ? currentIndex()
+                                     : nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+            pending_.fetch_add(1, std::memory_order_release);
+            {
+                std::lock_guard lock(queues_[index]->mutex);
+                queues_[index]->tasks.push_back(std::move(task));
+            }
+            {
+                std::lock_guard lock(sleepMutex_);
+            }
+            wake_.notify_one();
+        }
+
+        template<typename Func>
+        auto async(Func &&func) -> std::future<std::invoke_result_t<Func> > {
+            using Result = std::invoke_result_t<Func>;
+            auto task = std::make_shared<std::packaged_task<Result()> >(std::forward<Func>(func));
+            std::future<Result> future = task->get_future();
+            submit([task] { (*task)(); });
+            return future;
+        }
+
+        // Runs one queued task on the calling thread if any is available. Used by waiters to help instead of
+        // blocking, which keeps nested fork-join work from deadlocking the pool.
+        bool tryRunOne() {
+            Task task;
+            if (!tryPop(task)) {
+                return false;
+            }
+            task();
+            return true;
+        }
+
+    private:
+        bool tryPop(Task &task) {
+            const size_t count = queues_.size();
+            const bool worker = isWorkerThread();
+            const size_t self = worker ? currentIndex() : 0;
+            if (worker) {
+                std::lock_guard lock(queues_[self]->mutex);
+                if (!queues_[self]->tasks.empty()) {
+                    task = std::move(queues_[self]->tasks.back());
+                    queues_[self]->tasks.pop_back();
+                    pending_.fetch_sub(1, std::memory_order_acq_rel);
+                    return true;
+                }
+            }
+            for (size_t offset = worker ? 1 : 0; offset < count; ++offset) {
+                WorkQueue &victim = *queues_[(self + offset) % count];
+                std::lock_guard lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    pending_.fetch_sub(1, std::memory_order_acq_rel);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void workerLoop(const size_t index) {
+            currentPool() = this;
+            currentIndex() = index;
+            while (true) {
+                if (tryRunOne()) {
+                    continue;
+                }
+                std::unique_lock lock(sleepMutex_);
+                wake_.wait(lock, [this] {
+                    return stopping_.load() || pending_.load(std::memory_order_acquire) > 0;
+                });
+                if (stopping_.load() && pending_.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+            }
+        }
+    };
+
+    // Fork-join scope over a ThreadPool. wait() helps run queued tasks until every task of the group is done.
+    class TaskGroup {
+        ThreadPool &pool_;
+        std::atomic<size_t> outstanding_{0};
+        std::exception_ptr exception_;
+        std::mutex exceptionMutex_;
+
+    public:
+        explicit TaskGroup(ThreadPool &pool) : pool_(pool) {
+        }
+
+        TaskGroup(const TaskGroup &) = delete;
+        TaskGroup &operator=(const TaskGroup &) = delete;
+
+        ~TaskGroup() {
+            waitAll();
+        }
+
+        template<typename Func>
+        void run(Func &&func) {
+            outstanding_.fetch_add(1, std::memory_order_relaxed);
+            pool_.submit([this, func = std::forward<Func>(func)]() mutable {
+                try {
+                    func();
+                } catch (...) {
+                    std::lock_guard lock(exceptionMutex_);
+                    if (!exception_) {
+                        exception_ = std::current_exception();
+                    }
+                }
+                outstanding_.fetch_sub(1, std::memory_order_acq_rel);
+            });
+        }
+
+        // Blocks until all tasks finished and rethrows the first exception one of them raised.
+        void wait() {
+            waitAll();
+            if (exception_) {
+                std::rethrow_exception(std::exchange(exception_, nullptr));
+            }
+        }
+
+    private:
+        void waitAll() {
+            while (outstanding_.load(std::memory_order_acquire) > 0) {
+                if (!pool_.tryRunOne()) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    };
+}
+
+#endif //THREADPOOL_HPP
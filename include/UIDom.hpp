@@ -3,59 +3,29 @@
 #ifndef UIDOM_HPP
 #define UIDOM_HPP
 
-#include <webview/webview.h>
 #include <rfl/json.hpp>
-#include <random>
 #include <rfl.hpp>
+#include <atomic>
 #include <memory>
 #include "ScreenUtils.hpp"
+#include "AsyncBindings.hpp"
+#include "BridgeEncoding.hpp"
+#include "BridgeQueue.hpp"
+#include "ComponentNode.hpp"
+#include "FileUtils.hpp"
+#include "FrameClock.hpp"
+#include "LayoutEngine.hpp"
+#include "RenderPass.hpp"
+#include "RpcBindings.hpp"
+#include "StreamBindings.hpp"
+#include "ThreadPool.hpp"
+#include "ViewportCuller.hpp"
+#include "WebviewBackend.hpp"
+#include "WidgetSnapshot.hpp"
+#include "WidgetStore.hpp"
 #include "Log.hpp"
 
 namespace groklab {
-    struct Widget {
-        enum class WidgetType {
-            Undefined,
-            Layout,
-            // Text elements
-            TextElement,
-            Label,
-            Paragraph,
-            Span,
-            Link,
-            Markdown,
-            Html,
-        };
-
-        enum class LayoutType {
-            Horizontal,
-            Vertical,
-        };
-
-        Widget() = default;
-
-        std::string id{};
-        graaf::vertex_id_t nodeId{0};
-        WidgetType type{WidgetType::Undefined};
-        bool visible{true};
-        std::map<std::string, std::string> attributes;
-
-        [[nodiscard]] std::string_view getAttribute(const std::string &key) const {
-            const auto it = attributes.find(key);
-            if (it != attributes.end()) {
-                return it->second;
-            }
-            return "";
-        }
-
-        void setAttribute(const std::string &key, const std::string &value) {
-            attributes[key] = value;
-        }
-
-        [[nodiscard]] bool hasAttribute(const std::string &key) const {
-            return attributes.contains(key);
-        }
-    };
-
     struct WidgetEdgeProperties {
         bool visible;
     };
@@ -72,15 +42,48 @@ namespace groklab {
         virtual ~HtmlGenerator() = default;
 
         [[nodiscard]] virtual std::string generateHtml(const WidgetGraphType &widgetGraph) const = 0;
+
+        // Page for a viewport with the widgets far outside it left out. Generators that cannot cull emit the
+        // whole page.
+        [[nodiscard]] virtual std::string generateVisibleHtml(const WidgetGraphType &widgetGraph,
+                                                              const ViewportCuller & /*culler*/,
+                                                              const ScreenRect & /*viewport*/) const {
+            return generateHtml(widgetGraph);
+        }
+    };
+
+    struct CountRequest {
+        std::string method;
+    };
+
+    struct CountResponse {
+        std::string method;
+        uint64_t id;
     };
 
     class FluidUI {
         using WidgetGraphType = HtmlGenerator::WidgetGraphType;
-        std::unique_ptr<webview::webview> webview_;
+        static constexpr auto kRuntimeScriptPath = "./web/js/fluid/runtime.js";
+        std::unique_ptr<WebviewBackend> webview_;
+        WidgetStore widgetStore_;
+        LayoutEngine layoutEngine_{widgetStore_};
+        ScreenSize viewport_{};
         WidgetGraphType widgetGraph_{};
         graaf::vertex_id_t parentVertexId_{};
         graaf::vertex_id_t currentVertexId_{};
         std::unique_ptr<HtmlGenerator> htmlGenerator_;
+        ComponentNode::NodePtr rootComponent_;
+        std::unique_ptr<ThreadPool> renderPool_;
+        RenderPass renderPass_;
+        BridgeQueue bridge_;
+        std::atomic<bool> frameRequested_{false};
+        std::unique_ptr<RpcBindings> rpc_;
+        // Destroyed before webview_, so pending calls are cancelled and unbound while the webview still exists.
+        std::unique_ptr<AsyncBindings> asyncBindings_;
+        std::unique_ptr<StreamBindings> streamBindings_;
+        std::unique_ptr<ViewportCuller> culler_;
+        // Declared last: stopped first, so no frame is scheduled while the members above are destroyed.
+        FrameClock frameClock_{[this] { webview_->dispatch([this] { renderFrame(); }); }};
 
     public:
         explicit FluidUI(const std::string &title, std::unique_ptr<HtmlGenerator> htmlGenerator)
@@ -94,24 +97,260 @@ namespace groklab {
             initialize(title, width, height);
         }
 
-        void generate() const {
-            struct Res {
-                std::string method;
-                std::string id;
-            };
+        // Runs on the given backend instead of a native window, e.g. a HeadlessWebviewBackend in tests.
+        explicit FluidUI(const std::string &title, int width, int height, std::unique_ptr<HtmlGenerator> htmlGenerator,
+                         std::unique_ptr<WebviewBackend> backend)
+            : webview_(std::move(backend)), htmlGenerator_(std::move(htmlGenerator)) {
+            initialize(title, width, height);
+        }
+
+        ~FluidUI() {
+            // The component tree may outlive this window.
+            if (rootComponent_ != nullptr) {
+                rootComponent_->setDirtyHook({});
+            }
+        }
+
+        void generate() {
             if (htmlGenerator_ == nullptr) {
                 critical("HtmlGenerator is not initialized");
                 return;
             }
-            std::string html = htmlGenerator_->generateHtml(widgetGraph_);
-            auto a = webview_->bind("count",
-                [&](const std::string &req) -> std::string {
-                info("Request from:  {}", req);
-                    const Res res = {req, generateRandomId()};
-                    const std::string result = rfl::json::write(res);
-                return result;
+            std::string html;
+            if (culler_ != nullptr) {
+                layout();
+                culler_->rebuild(0);
+                html = htmlGenerator_->generateVisibleHtml(widgetGraph_, *culler_, {{0, 0}, viewport_});
+            } else {
+                html = htmlGenerator_->generateHtml(widgetGraph_);
+            }
+            if (rootComponent_ != nullptr) {
+                // Component markup goes at the end of the body; its values arrive with the first patches.
+                std::string markup;
+                rootComponent_->appendMarkup(markup);
+                const size_t body = html.rfind("</body>");
+                html.insert(body == std::string::npos ? html.size() : body, markup);
+            }
+            rpc_->bind("count", [](const CountRequest &request) -> CountResponse {
+                info("Request from:  {}", request.method);
+                return {request.method, RpcBindings::nextRequestId()};
+            });
+            // Calls made by the page being replaced can no longer be settled.
+            if (asyncBindings_ != nullptr) {
+                asyncBindings_->cancelAll();
+            }
+            if (streamBindings_ != nullptr) {
+                streamBindings_->cancelAll();
+            }
+            webview_->setHtml(html);
+        }
+
+        // Every change in the component tree, from any thread, then schedules a frame through requestFrame().
+        // Call on the UI thread.
+        void setRootComponent(ComponentNode::NodePtr rootComponent) {
+            if (rootComponent_ != nullptr) {
+                rootComponent_->setDirtyHook({});
+            }
+            rootComponent_ = std::move(rootComponent);
+            if (rootComponent_ != nullptr) {
+                rootComponent_->setDirtyHook([this] { requestFrame(); });
+                requestFrame();
+            }
+        }
+
+        // Chooses serial or parallel rendering; threadCount 0 uses one worker per hardware thread.
+        void setRenderMode(const RenderMode mode, const size_t threadCount = 0) {
+            if (mode == RenderMode::Parallel) {
+                if (renderPool_ == nullptr || (threadCount != 0 && renderPool_->size() != threadCount)) {
+                    renderPool_ = threadCount == 0 ? std::make_unique<ThreadPool>()
+                                                   : std::make_unique<ThreadPool>(threadCount);
+                }
+                renderPass_.setMode(RenderMode::Parallel, renderPool_.get());
+            } else {
+                renderPass_.setMode(RenderMode::Serial);
+                renderPool_.reset();
+            }
+        }
+
+        // Sends a JSON payload to the page's window.fluid.on(channel, ...) listeners with the next frame. Safe to
+        // call from any thread; repeated posts to the same channel and key before the frame only send the last.
+        void post(const std::string_view channel, const std::string_view key, std::string jsonPayload) {
+            if (bridge_.post(channel, key, std::move(jsonPayload))) {
+                requestFrame();
+            }
+        }
+
+        // Encodes value for the page, as JSON or as CBOR for bulk numeric data, and posts it like above.
+        template<typename T>
+        void post(const std::string_view channel, const std::string_view key, const T &value,
+                  const BridgeEncoding encoding) {
+            post(channel, key, BridgeCodec::toScript(value, encoding));
+        }
+
+        // Like post(), but every event is delivered.
+        void postEvent(const std::string_view channel, std::string jsonPayload) {
+            if (bridge_.postEvent(channel, std::move(jsonPayload))) {
+                requestFrame();
+            }
+        }
+
+        // Binds a typed handler, see RpcBindings; the page calls it via window.fluid.rpc.<name>(request).
+        template<typename Func>
+        void bindRpc(const std::string &name, Func &&func, const BridgeEncoding encoding = BridgeEncoding::kJson) {
+            if (rpc_ == nullptr) {
+                critical("FluidUI is not initialized");
+                return;
+            }
+            rpc_->bind(name, std::forward<Func>(func), encoding);
+        }
+
+        // Binds a handler that runs on the shared async binding pool; the page calls it via window.fluid.invoke().
+        void bindAsync(const std::string &name, AsyncBindings::Handler handler,
+                       const AsyncBindings::Options options = {}) {
+            if (webview_ == nullptr) {
+                critical("FluidUI is not initialized");
+                return;
+            }
+            if (asyncBindings_ == nullptr) {
+                asyncBindings_ = std::make_unique<AsyncBindings>(*webview_);
+            }
+            asyncBindings_->bind(name, std::move(handler), options);
+        }
+
+        // Binds a producer that streams its items to the page in bounded chunks; see StreamBindings.
+        void bindStream(const std::string &name, StreamBindings::Producer producer,
+                        const StreamBindings::Options options = {}) {
+            if (webview_ == nullptr) {
+                critical("FluidUI is not initialized");
+                return;
+            }
+            if (streamBindings_ == nullptr) {
+                streamBindings_ = std::make_unique<StreamBindings>(*webview_);
+            }
+            streamBindings_->bind(name, std::move(producer), options);
+        }
+
+        [[nodiscard]] BridgeQueue::Metrics getBridgeMetrics() const {
+            return bridge_.getMetrics();
+        }
+
+        // Renders the dirty parts of the component tree and sends their patches together with the queued bridge
+        // messages in one eval. Must run on the UI thread; use requestFrame() from anywhere else.
+        void renderFrame() {
+            frameRequested_.store(false, std::memory_order_release);
+            if (webview_ == nullptr) {
+                return;
+            }
+            std::string script = bridge_.takeScript();
+            if (rootComponent_ != nullptr) {
+                renderPass_.run(*rootComponent_);
+                if (!renderPass_.empty()) {
+                    debug("Render pass visited {} components, sending {} patches",
+                          renderPass_.getVisitedCount(), renderPass_.getPatchCount());
+                    script.append(renderPass_.takeScript());
+                } else {
+                    renderPass_.reset();
+                }
+            }
+            if (!script.empty()) {
+                webview_->eval(script);
+            }
+        }
+
+        // Schedules renderFrame() on the UI thread, at most once per frame interval; requests made before it runs
+        // are coalesced into one frame.
+        void requestFrame() {
+            if (webview_ == nullptr || frameRequested_.exchange(true, std::memory_order_acq_rel)) {
+                return;
+            }
+            frameClock_.request();
+        }
+
+        // Minimum time between frames, FrameClock::kDefaultInterval unless changed; zero sends every frame as soon
+        // as it is requested.
+        void setFrameInterval(const FrameClock::Duration interval) {
+            frameClock_.setInterval(interval);
+        }
+
+        // Adds a widget under parent (kNoWidget for a root). The store and the graph share the widget's id, and the
+        // graph vertex only refers to the store for the widget's id string and attributes.
+        graaf::vertex_id_t addWidget(const Widget::WidgetType type, const std::string_view id,
+                                     const graaf::vertex_id_t parent) {
+            const WidgetId widget = widgetStore_.add(type, id, static_cast<WidgetId>(parent));
+            const graaf::vertex_id_t vertex = widgetGraph_.add_vertex(widgetStore_.makeWidget(widget));
+            if (vertex != widget) {
+                critical("Widget graph and store are out of sync: vertex {} for widget {}", vertex, widget);
+            }
+            if (parent != kNoWidget) {
+                widgetGraph_.add_edge(parent, vertex, WidgetEdgeProperties{true});
+            }
+            currentVertexId_ = vertex;
+            return vertex;
+        }
+
+        graaf::vertex_id_t addWidget(const Widget::WidgetType type, const std::string_view id) {
+            return addWidget(type, id, parentVertexId_);
+        }
+
+        [[nodiscard]] WidgetStore &getWidgetStore() {
+            return widgetStore_;
+        }
+
+        [[nodiscard]] const WidgetGraphType &getWidgetGraph() const {
+            return widgetGraph_;
+        }
+
+        // Lays out the widget tree in the window size; call LayoutEngine::markDirty() for widgets that changed.
+        void layout() {
+            layoutEngine_.layout(0, viewport_);
+        }
+
+        void setViewport(const ScreenSize viewport) {
+            viewport_ = viewport;
+        }
+
+        [[nodiscard]] LayoutEngine &getLayoutEngine() {
+            return layoutEngine_;
+        }
+
+        // Writes the widget tree to a snapshot that restoreSnapshot() maps back in on a later start.
+        bool saveSnapshot(const std::filesystem::path &path) const {
+            return WidgetSnapshot::write(path, widgetStore_, widgetGraph_);
+        }
+
+        // Replaces the widget tree with a snapshot instead of building it in code. Returns false, with the tree
+        // untouched, if there is no usable snapshot at path.
+        bool restoreSnapshot(const std::filesystem::path &path) {
+            WidgetGraphType graph;
+            if (!WidgetSnapshot::restore(path, widgetStore_, graph)) {
+                return false;
+            }
+            widgetGraph_ = std::move(graph);
+            parentVertexId_ = 0;
+            currentVertexId_ = widgetStore_.empty() ? 0 : widgetStore_.size() - 1;
+            layoutEngine_.reset();
+            return true;
+        }
+
+        // Makes generate() emit only the widgets within overscan pixels of the window, with spacers standing in
+        // for the rest; the page asks for the widgets of a new region as it scrolls.
+        void enableViewportCulling(const int overscan = 1000) {
+            culler_ = std::make_unique<ViewportCuller>(widgetStore_, layoutEngine_, overscan);
+            webview_->bind(ViewportCuller::kViewportBinding, [this](const std::string &request) -> std::string {
+                const auto viewport = rfl::json::read<std::tuple<int, int, int, int> >(request);
+                if (!viewport) {
+                    error("Invalid viewport {}", request);
+                    return "null";
+                }
+                const auto [x, y, width, height] = viewport.value();
+                std::string json;
+                StringUtils::appendJsonString(json, culler_->emitHtml({{x, y}, {width, height}}));
+                return json;
             });
-            webview_->set_html(html);
+        }
+
+        [[nodiscard]] WebviewBackend &getBackend() const {
+            return *webview_;
         }
 
         void run() const {
@@ -125,24 +364,22 @@ namespace groklab {
     private:
         void initialize(const std::string &title, int width, int height) {
             try {
-                webview_ = std::make_unique<webview::webview>(true, nullptr);
-                webview_->set_title(title);
-                webview_->set_size(width, height, WEBVIEW_HINT_NONE);
-                parentVertexId_ = widgetGraph_.add_vertex(ParentLayout{});
+                if (webview_ == nullptr) {
+                    webview_ = std::make_unique<NativeWebviewBackend>(true);
+                }
+                webview_->setTitle(title);
+                webview_->setSize(width, height);
+                viewport_ = {width, height};
+                if (FileUtils::fileExists(kRuntimeScriptPath)) {
+                    webview_->init(FileUtils::readFileAsString(kRuntimeScriptPath));
+                }
+                rpc_ = std::make_unique<RpcBindings>(*webview_);
+                parentVertexId_ = addWidget(Widget::WidgetType::Layout, "root", kNoWidget);
             } catch (const webview::exception &e) {
                 critical("Failed to initialize FluidUI with error {}", e.what());
                 throw;
             }
         }
-
-        // Function to generate a random ID
-        [[nodiscard]] static std::string generateRandomId() {
-            std::random_device rd;
-            std::mt19937 gen(rd());
-            std::uniform_int_distribution<> dis(1000, 9999);
-
-            return std::to_string(dis(gen));
-        }
     };
 }
 
@@ -0,0 +1,334 @@
+#pragma once
+
+#ifndef VIEWPORTCULLER_HPP
+#define VIEWPORTCULLER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "LayoutEngine.hpp"
+#include "ScreenUtils.hpp"
+#include "WidgetMarkup.hpp"
+#include "WidgetStore.hpp"
+
+namespace groklab {
+    // Uniform grid over widget boxes. Each widget is listed in every cell its box touches, in one flat array
+    // with per-cell offsets, so a query costs the cells it covers plus the widgets listed in them.
+    class SpatialGrid {
+        int cellSize_{256};
+        int originX_{0};
+        int originY_{0};
+        int columns_{0};
+        int rows_{0};
+        std::vector<uint32_t> cellBegin_;
+        std::vector<WidgetId> entries_;
+
+    public:
+        explicit SpatialGrid(const int cellSize = 256) : cellSize_(std::max(1, cellSize)) {
+        }
+
+        // Indexes the given widgets over the area their boxes cover.
+        void build(const std::vector<std::pair<WidgetId, ScreenRect> > &boxes) {
+            int left = 0;
+            int top = 0;
+            int right = 0;
+            int bottom = 0;
+            for (const auto &[widget, box]: boxes) {
+                left = std::min(left, box.position.x);
+                top = std::min(top, box.position.y);
+                right = std::max(right, box.position.x + box.size.width);
+                bottom = std::max(bottom, box.position.y + box.size.height);
+            }
+            originX_ = left;
+            originY_ = top;
+            columns_ = std::max(1, (right - left + cellSize_ - 1) / cellSize_);
+            rows_ = std::max(1, (bottom - top + cellSize_ - 1) / cellSize_);
+            cellBegin_.assign(static_cast<size_t>(columns_) * rows_ + 1, 0);
+            forEachCell(boxes, [&](const size_t cell, WidgetId) { ++cellBegin_[cell + 1]; });
+            for (size_t cell = 1; cell < cellBegin_.size(); ++cell) {
+                cellBegin_[cell] += cellBegin_[cell - 1];
+            }
+            entries_.resize(cellBegin_.back());
+            std::vector<uint32_t> fill(cellBegin_.begin(), cellBegin_.end() - 1);
+            forEachCell(boxes, [&](const size_t cell, const WidgetId widget) { entries_[fill[cell]++] = widget; });
+        }
+
+        // Appends the widgets listed in the cells area touches, sorted and without duplicates. The result may
+        // contain widgets that share a cell with area without intersecting it.
+        void query(const ScreenRect &area, std::vector<WidgetId> &result) const {
+            if (cellBegin_.empty()) {
+                return;
+            }
+            const size_t first = result.size();
+            const auto [left, top, right, bottom] = cellRange(area);
+            for (int row = top; row <= bottom; ++row) {
+                for (int column = left; column <= right; ++column) {
+                    const size_t cell = static_cast<size_t>(row) * columns_ + column;
+                    result.insert(result.end(), entries_.begin() + cellBegin_[cell],
+                                  entries_.begin() + cellBegin_[cell + 1]);
+                }
+            }
+            std::sort(result.begin() + static_cast<std::ptrdiff_t>(first), result.end());
+            result.erase(std::unique(result.begin() + static_cast<std::ptrdiff_t>(first), result.end()),
+                         result.end());
+        }
+
+        [[nodiscard]] size_t getEntryCount() const {
+            return entries_.size();
+        }
+
+    private:
+        struct CellRange {
+            int left;
+            int top;
+            int right;
+            int bottom;
+        };
+
+        [[nodiscard]] CellRange cellRange(const ScreenRect &area) const {
+            auto clampColumn = [&](const int x) { return std::clamp((x - originX_) / cellSize_, 0, columns_ - 1); };
+            auto clampRow = [&](const int y) { return std::clamp((y - originY_) / cellSize_, 0, rows_ - 1); };
+            const int right = area.position.x + std::max(0, area.size.width - 1);
+            const int bottom = area.position.y + std::max(0, area.size.height - 1);
+            return {clampColumn(area.position.x), clampRow(area.position.y), clampColumn(right), clampRow(bottom)};
+        }
+
+        template<typename Fn>
+        void forEachCell(const std::vector<std::pair<WidgetId, ScreenRect> > &boxes, Fn &&fn) const {
+            for (const auto &[widget, box]: boxes) {
+                const auto [left, top, right, bottom] = cellRange(box);
+                for (int row = top; row <= bottom; ++row) {
+                    for (int column = left; column <= right; ++column) {
+                        fn(static_cast<size_t>(row) * columns_ + column, widget);
+                    }
+                }
+            }
+        }
+    };
+
+    // Emits only the part of a laid out widget tree near the viewport. Widgets without visible children are
+    // indexed in a SpatialGrid; a viewport query finds those within the overscan margin, and they are emitted
+    // together with their ancestors. Every run of skipped siblings becomes one spacer element as long as the
+    // run, so the page keeps its full scroll size, and the cost depends on what is visible rather than on the
+    // size of the tree.
+    //
+    // Every emitted element carries its computed box size, so the browser places widgets and spacers exactly
+    // where the layout did. The root element carries data-fluid-virtual="x,y,width,height", the region that was
+    // emitted; once the page scrolls out of it, runtime.js asks for the new region through the __fluid_viewport
+    // binding and patches the page, matching elements by data-fluid-key, so only spacers and the widgets that
+    // enter or leave the region change.
+    class ViewportCuller {
+    public:
+        static constexpr auto kViewportBinding = "__fluid_viewport";
+
+    private:
+        const WidgetStore &store_;
+        const LayoutEngine &layout_;
+        SpatialGrid grid_;
+        int overscan_;
+        WidgetId root_{kNoWidget};
+
+    public:
+        // overscan is the margin around the viewport, in pixels, that is emitted as well so short scrolls need
+        // no round trip.
+        ViewportCuller(const WidgetStore &store, const LayoutEngine &layout, const int overscan = 1000,
+                       const int cellSize = 256)
+            : store_(store), layout_(layout), grid_(cellSize), overscan_(std::max(0, overscan)) {
+        }
+
+        // Indexes the boxes of the tree under root; call after every LayoutEngine::layout().
+        void rebuild(const WidgetId root) {
+            root_ = root;
+            std::vector<std::pair<WidgetId, ScreenRect> > boxes;
+            if (root >= store_.size()) {
+                grid_.build(boxes);
+                return;
+            }
+            std::vector<WidgetId> stack{root};
+            while (!stack.empty()) {
+                const WidgetId widget = stack.back();
+                stack.pop_back();
+                bool leaf = true;
+                store_.forEachChild(widget, [&](const WidgetId child) {
+                    if (store_.isVisible(child)) {
+                        stack.push_back(child);
+                        leaf = false;
+                    }
+                });
+                if (leaf) {
+                    boxes.emplace_back(widget, layout_.getRect(widget));
+                }
+            }
+            grid_.build(boxes);
+        }
+
+        // Region emitted for a viewport: the viewport grown by the overscan margin.
+        [[nodiscard]] ScreenRect getRegion(const ScreenRect &viewport) const {
+            return {{viewport.position.x - overscan_, viewport.position.y - overscan_},
+                    {viewport.size.width + 2 * overscan_, viewport.size.height + 2 * overscan_}};
+        }
+
+        // Writes the markup of the root widget for a viewport, in layout coordinates, to out; returns the number
+        // of widgets emitted.
+        size_t emit(const ScreenRect &viewport, std::string &out) const {
+            if (root_ == kNoWidget || root_ >= store_.size()) {
+                return 0;
+            }
+            const ScreenRect region = getRegion(viewport);
+
+            // Visible leaves in the region, then the emitted children of every emitted layout.
+            std::vector<WidgetId> leaves;
+            grid_.query(region, leaves);
+            std::unordered_map<WidgetId, std::vector<WidgetId> > children;
+            std::unordered_set<WidgetId> registered;
+            std::vector<WidgetId> chain;
+            for (const WidgetId leaf: leaves) {
+                if (!intersects(layout_.getRect(leaf), region)) {
+                    continue;
+                }
+                chain.clear();
+                WidgetId widget = leaf;
+                while (widget != root_ && widget != kNoWidget) {
+                    chain.push_back(widget);
+                    widget = store_.getParent(widget);
+                }
+                if (widget != root_) {
+                    continue;
+                }
+                // Stops at the first widget a previous chain registered, along with everything above it.
+                for (const WidgetId link: chain) {
+                    if (!registered.insert(link).second) {
+                        break;
+                    }
+                    children[store_.getParent(link)].push_back(link);
+                }
+            }
+            for (auto &[parent, siblings]: children) {
+                std::sort(siblings.begin(), siblings.end());
+            }
+
+            const std::string extra = " data-fluid-virtual=\"" + std::to_string(region.position.x) + "," +
+                                      std::to_string(region.position.y) + "," + std::to_string(region.size.width) +
+                                      "," + std::to_string(region.size.height) + "\"";
+            size_t emitted = 0;
+            emitWidget(root_, children, out, extra, emitted);
+            return emitted;
+        }
+
+        [[nodiscard]] std::string emitHtml(const ScreenRect &viewport) const {
+            std::string html;
+            emit(viewport, html);
+            return html;
+        }
+
+    private:
+        static bool intersects(const ScreenRect &a, const ScreenRect &b) {
+            return a.position.x < b.position.x + b.size.width && b.position.x < a.position.x + a.size.width &&
+                   a.position.y < b.position.y + b.size.height && b.position.y < a.position.y + a.size.height;
+        }
+
+        static void appendSpacer(const bool horizontal, const int length, std::string &out) {
+            if (length <= 0) {
+                return;
+            }
+            out.append(horizontal ? "<div class=\"fluid-spacer\" style=\"flex:none;width:"
+                                  : "<div class=\"fluid-spacer\" style=\"flex:none;height:");
+            out.append(std::to_string(length));
+            out.append("px\"></div>");
+        }
+
+        // End of a layout's children along its main axis, which may lie past its own box when they overflow.
+        [[nodiscard]] int contentEnd(const WidgetId widget, const bool horizontal) const {
+            const WidgetId last = store_.getLastChild(widget);
+            const ScreenRect box = layout_.getRect(last != kNoWidget && store_.isVisible(last) ? last : widget);
+            return horizontal ? box.position.x + box.size.width : box.position.y + box.size.height;
+        }
+
+        // Attributes placing an emitted widget where the layout put it: data-fluid-key, for runtime.js to match it
+        // across updates, and its box size. Widgets with children become flex containers with the layout's
+        // direction, padding, gap and alignment, so children and spacers line up with the computed boxes. Leaves
+        // clip content that outgrows the measured size rather than move everything after them.
+        void appendBoxAttributes(const WidgetId widget, std::string &out) const {
+            const ScreenRect box = layout_.getRect(widget);
+            out.append(" data-fluid-key=\"").append(std::to_string(widget));
+            out.append("\" style=\"box-sizing:border-box;flex:none;width:").append(std::to_string(box.size.width));
+            out.append("px;height:").append(std::to_string(box.size.height)).append("px;");
+            if (store_.getFirstChild(widget) == kNoWidget) {
+                out.append("overflow:hidden\"");
+                return;
+            }
+            const LayoutStyle style = layout_.getLayoutStyle(widget);
+            out.append(style.direction == Widget::LayoutType::Horizontal ? "display:flex;flex-direction:row;"
+                                                                         : "display:flex;flex-direction:column;");
+            switch (style.align) {
+                case LayoutStyle::Align::kCenter: out.append("align-items:center;"); break;
+                case LayoutStyle::Align::kEnd: out.append("align-items:flex-end;"); break;
+                default: out.append("align-items:flex-start;"); break;
+            }
+            out.append("padding:").append(std::to_string(std::lround(style.padding)));
+            out.append("px;gap:").append(std::to_string(std::lround(style.gap))).append("px\"");
+        }
+
+        void emitWidget(const WidgetId widget, const std::unordered_map<WidgetId, std::vector<WidgetId> > &children,
+                        std::string &out, const std::string_view extra, size_t &emitted) const {
+            const Widget::WidgetType type = store_.getType(widget);
+            std::string attributes(extra);
+            appendBoxAttributes(widget, attributes);
+            WidgetMarkup::openTag(type, store_.isVisible(widget), &store_, widget, out, attributes);
+            ++emitted;
+
+            // Spacers stand in for the siblings skipped before, between and after the emitted children. Each is
+            // measured from the boxes on either side of its run, less the flex gaps the page adds around it.
+            const LayoutStyle style = layout_.getLayoutStyle(widget);
+            const bool horizontal = style.direction == Widget::LayoutType::Horizontal;
+            const int gap = static_cast<int>(std::lround(style.gap));
+            auto start = [&](const ScreenRect &box) { return horizontal ? box.position.x : box.position.y; };
+            auto end = [&](const ScreenRect &box) {
+                return horizontal ? box.position.x + box.size.width : box.position.y + box.size.height;
+            };
+            int cursor = start(layout_.getRect(widget)) + static_cast<int>(std::lround(style.padding));
+            // Whether an element precedes the next one in the flex line, i.e. whether a gap separates them.
+            bool placed = false;
+            auto skip = [&](const int runEnd) {
+                if (const int length = runEnd - cursor - (placed ? gap : 0); length > 0) {
+                    appendSpacer(horizontal, length, out);
+                    placed = true;
+                }
+            };
+
+            const auto it = children.find(widget);
+            if (it == children.end()) {
+                // Only the root is emitted without any of its children, when none of them reach the region.
+                if (widget == root_ && store_.getFirstChild(widget) != kNoWidget) {
+                    skip(contentEnd(widget, horizontal));
+                }
+                WidgetMarkup::closeTag(type, out);
+                return;
+            }
+            WidgetId previous = kNoWidget;
+            for (const WidgetId child: it->second) {
+                const ScreenRect box = layout_.getRect(child);
+                const WidgetId expected = previous == kNoWidget ? store_.getFirstChild(widget)
+                                                                : store_.getNextSibling(previous);
+                if (expected != child) {
+                    skip(start(box) - gap);
+                }
+                emitWidget(child, children, out, {}, emitted);
+                cursor = end(box);
+                placed = true;
+                previous = child;
+            }
+            if (store_.getNextSibling(previous) != kNoWidget) {
+                skip(contentEnd(widget, horizontal));
+            }
+            WidgetMarkup::closeTag(type, out);
+        }
+    };
+}
+
+#endif //VIEWPORTCULLER_HPP
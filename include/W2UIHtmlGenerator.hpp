@@ -2,19 +2,284 @@
 
 #ifndef HTMLGENERATOR_HPP
 #define HTMLGENERATOR_HPP
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <graaflib/graph.h>
 
+#include "FileUtils.hpp"
+#include "ThreadPool.hpp"
 #include "UIDom.hpp"
+#include "WidgetMarkup.hpp"
 
 namespace groklab {
+    // Generates the page from the widget graph. The graph is walked depth first from its root layout (vertex 0,
+    // the first widget FluidUI creates), children in creation order, which with dense ids is ascending vertex id.
+    // Text and attribute values are escaped while they are copied, and the markup is written to a sink in
+    // bounded pieces rather than built up as one string.
+    //
+    // Widgets are emitted inside the <q-app> element of ./web/vue/index-gen.html, which is read once. With a
+    // ThreadPool, subtrees of at least grainSize widgets are emitted on the pool into buffers of their own and
+    // written out in document order, so the output is the same as the serial one.
     class W2UIHtmlGenerator : public HtmlGenerator {
     public:
-        W2UIHtmlGenerator() = default;
+        static constexpr auto kTemplatePath = "./web/vue/index-gen.html";
+
+    private:
+        static constexpr size_t kSinkChunk = 64 * 1024;
+        static constexpr uint32_t kNoVertex = UINT32_MAX;
+
+        // Children of every vertex in one array, per vertex a [begin, end) range into it.
+        struct Topology {
+            std::vector<const Widget *> widgets;
+            std::vector<uint32_t> childBegin;
+            std::vector<uint32_t> children;
+            std::vector<uint32_t> subtreeSize;
+
+            [[nodiscard]] std::pair<const uint32_t *, const uint32_t *> childrenOf(const uint32_t vertex) const {
+                return {children.data() + childBegin[vertex], children.data() + childBegin[vertex + 1]};
+            }
+        };
+
+        // Output in document order: literal markup of split ancestors, or a subtree emitted by a task.
+        struct Piece {
+            std::string literal;
+            uint32_t subtree{kNoVertex};
+        };
+
+        ThreadPool *pool_{nullptr};
+        size_t grainSize_{4096};
+        std::string prefix_;
+        std::string suffix_;
+
+    public:
+        explicit W2UIHtmlGenerator(ThreadPool *pool = nullptr, const size_t grainSize = 4096)
+            : pool_(pool), grainSize_(std::max<size_t>(1, grainSize)) {
+            std::string page = FileUtils::fileExists(kTemplatePath)
+                                   ? FileUtils::readFileAsString(kTemplatePath)
+                                   : std::string("<!DOCTYPE html>\n<html>\n<body>\n</body>\n</html>\n");
+            size_t split = page.find("</q-app>");
+            if (split == std::string::npos) {
+                split = page.find("</body>");
+            }
+            if (split == std::string::npos) {
+                split = page.size();
+            }
+            prefix_ = page.substr(0, split);
+            suffix_ = page.substr(split);
+        }
+
         ~W2UIHtmlGenerator() override = default;
 
         [[nodiscard]] std::string generateHtml(const WidgetGraphType &widgetGraph) const override {
-            return FileUtils::readFileAsString("./web/vue/index-gen.html");
+            std::string html;
+            html.reserve(prefix_.size() + suffix_.size() + widgetGraph.vertex_count() * 64);
+            generate(widgetGraph, [&html](const std::string_view piece) { html.append(piece); });
+            return html;
+        }
+
+        [[nodiscard]] std::string generateVisibleHtml(const WidgetGraphType & /*widgetGraph*/,
+                                                      const ViewportCuller &culler,
+                                                      const ScreenRect &viewport) const override {
+            std::string html = prefix_;
+            culler.emit(viewport, html);
+            html.append(suffix_);
+            return html;
+        }
+
+        // Writes the page to sink(std::string_view) in pieces of up to about 64 KiB.
+        template<typename Sink>
+        void generate(const WidgetGraphType &widgetGraph, Sink &&sink) const {
+            sink(std::string_view(prefix_));
+            if (widgetGraph.vertex_count() > 0 && widgetGraph.has_vertex(0)) {
+                const Topology topology = buildTopology(widgetGraph);
+                if (pool_ == nullptr || topology.subtreeSize[0] < grainSize_ * 2) {
+                    std::string buffer;
+                    buffer.reserve(kSinkChunk + 4096);
+                    emitSubtree(topology, 0, buffer, sink);
+                    sink(std::string_view(buffer));
+                } else {
+                    emitParallel(topology, sink);
+                }
+            }
+            sink(std::string_view(suffix_));
+        }
+
+    private:
+        template<typename Edge>
+        static bool isVisible(const Edge &edge) {
+            if constexpr (requires { edge->visible; }) {
+                return edge->visible;
+            } else {
+                return edge.visible;
+            }
+        }
+
+        static Topology buildTopology(const WidgetGraphType &widgetGraph) {
+            Topology topology;
+            size_t vertexCount = 0;
+            for (const auto &[id, widget]: widgetGraph.get_vertices()) {
+                vertexCount = std::max<size_t>(vertexCount, id + 1);
+            }
+            topology.widgets.assign(vertexCount, nullptr);
+            for (const auto &[id, widget]: widgetGraph.get_vertices()) {
+                topology.widgets[id] = &widget;
+            }
+
+            // Counting sort of the edges by source; hidden edges drop their subtree.
+            topology.childBegin.assign(vertexCount + 1, 0);
+            for (const auto &[edgeId, edge]: widgetGraph.get_edges()) {
+                if (isVisible(edge)) {
+                    ++topology.childBegin[edgeId.first + 1];
+                }
+            }
+            for (size_t i = 0; i < vertexCount; ++i) {
+                topology.childBegin[i + 1] += topology.childBegin[i];
+            }
+            topology.children.resize(topology.childBegin[vertexCount]);
+            std::vector<uint32_t> fill(topology.childBegin.begin(), topology.childBegin.end() - 1);
+            for (const auto &[edgeId, edge]: widgetGraph.get_edges()) {
+                if (isVisible(edge)) {
+                    topology.children[fill[edgeId.first]++] = static_cast<uint32_t>(edgeId.second);
+                }
+            }
+            for (size_t i = 0; i < vertexCount; ++i) {
+                std::sort(topology.children.begin() + topology.childBegin[i],
+                          topology.children.begin() + topology.childBegin[i + 1]);
+            }
+
+            // Subtree sizes in post order, without recursion.
+            topology.subtreeSize.assign(vertexCount, 1);
+            std::vector<std::pair<uint32_t, bool> > stack{{0, false}};
+            while (!stack.empty()) {
+                auto [vertex, expanded] = stack.back();
+                stack.pop_back();
+                const auto [begin, end] = topology.childrenOf(vertex);
+                if (expanded) {
+                    for (const uint32_t *child = begin; child != end; ++child) {
+                        topology.subtreeSize[vertex] += topology.subtreeSize[*child];
+                    }
+                    continue;
+                }
+                stack.emplace_back(vertex, true);
+                for (const uint32_t *child = begin; child != end; ++child) {
+                    stack.emplace_back(*child, false);
+                }
+            }
+            return topology;
+        }
+
+        // Emits the subtree of root into buffer, handing full buffers to sink on the way.
+        template<typename Sink>
+        static void emitSubtree(const Topology &topology, const uint32_t root, std::string &buffer, Sink &sink) {
+            std::vector<std::pair<uint32_t, bool> > stack{{root, false}};
+            while (!stack.empty()) {
+                auto [vertex, closing] = stack.back();
+                stack.pop_back();
+                const Widget *widget = topology.widgets[vertex];
+                if (widget == nullptr) {
+                    continue;
+                }
+                if (closing) {
+                    WidgetMarkup::closeTag(widget->type, buffer);
+                } else {
+                    WidgetMarkup::openTag(*widget, buffer);
+                    stack.emplace_back(vertex, true);
+                    const auto [begin, end] = topology.childrenOf(vertex);
+                    for (const uint32_t *child = end; child != begin; --child) {
+                        stack.emplace_back(*(child - 1), false);
+                    }
+                }
+                if (buffer.size() >= kSinkChunk) {
+                    sink(std::string_view(buffer));
+                    buffer.clear();
+                }
+            }
+        }
+
+        // Splits the tree into subtrees of about grainSize_ widgets, emits them on the pool and writes the pieces
+        // in document order.
+        template<typename Sink>
+        void emitParallel(const Topology &topology, Sink &sink) const {
+            std::vector<Piece> pieces;
+            std::vector<std::pair<uint32_t, bool> > stack{{0, false}};
+            while (!stack.empty()) {
+                auto [vertex, closing] = stack.back();
+                stack.pop_back();
+                const Widget *widget = topology.widgets[vertex];
+                if (widget == nullptr) {
+                    continue;
+                }
+                if (!closing && topology.subtreeSize[vertex] <= grainSize_) {
+                    pieces.push_back({{}, vertex});
+                    continue;
+                }
+                if (pieces.empty() || pieces.back().subtree != kNoVertex) {
+                    pieces.emplace_back();
+                }
+                if (closing) {
+                    WidgetMarkup::closeTag(widget->type, pieces.back().literal);
+                    continue;
+                }
+                WidgetMarkup::openTag(*widget, pieces.back().literal);
+                stack.emplace_back(vertex, true);
+                const auto [begin, end] = topology.childrenOf(vertex);
+                for (const uint32_t *child = end; child != begin; --child) {
+                    stack.emplace_back(*(child - 1), false);
+                }
+            }
+
+            // Neighbouring small subtrees share a task, so each task has about grainSize_ widgets to emit; a task
+            // never spans a literal piece.
+            std::vector<std::pair<size_t, size_t> > tasks;
+            size_t taskWidgets = 0;
+            bool split = true;
+            for (size_t i = 0; i < pieces.size(); ++i) {
+                if (pieces[i].subtree == kNoVertex) {
+                    split = true;
+                    continue;
+                }
+                if (split || taskWidgets >= grainSize_) {
+                    split = false;
+                    tasks.emplace_back(i, i + 1);
+                    taskWidgets = 0;
+                }
+                tasks.back().second = i + 1;
+                taskWidgets += topology.subtreeSize[pieces[i].subtree];
+            }
+
+            std::vector<std::string> outputs(tasks.size());
+            TaskGroup group(*pool_);
+            for (size_t task = 0; task < tasks.size(); ++task) {
+                group.run([&, task] {
+                    // emitSubtree flushes full buffers to its sink, so it writes into a scratch buffer whose
+                    // chunks, and finally its remainder, go to the task's output.
+                    std::string &out = outputs[task];
+                    std::string scratch;
+                    scratch.reserve(kSinkChunk + 4096);
+                    auto append = [&out](const std::string_view piece) { out.append(piece); };
+                    for (size_t i = tasks[task].first; i < tasks[task].second; ++i) {
+                        if (pieces[i].subtree != kNoVertex) {
+                            emitSubtree(topology, pieces[i].subtree, scratch, append);
+                        }
+                    }
+                    out.append(scratch);
+                });
+            }
+            group.wait();
+
+            size_t task = 0;
+            for (size_t i = 0; i < pieces.size(); ++i) {
+                if (pieces[i].subtree == kNoVertex) {
+                    sink(std::string_view(pieces[i].literal));
+                } else {
+                    sink(std::string_view(outputs[task]));
+                    i = tasks[task++].second - 1;
+                }
+            }
         }
     };
 }
@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef WEBVIEWBACKEND_HPP
+#define WEBVIEWBACKEND_HPP
+
+#include <webview/webview.h>
+#include <functional>
+#include <string>
+
+namespace groklab {
+    // The part of webview FluidUI and the binding layers use. NativeWebviewBackend drives a real window;
+    // HeadlessWebviewBackend records the calls instead, so the pipeline runs without a display.
+    //
+    // Threading follows webview: everything runs on the UI thread except dispatch() and resolve(), which may be
+    // called from any thread.
+    class WebviewBackend {
+    public:
+        // Receives the webview request id and the JSON array of arguments; answers later through resolve().
+        using Binding = std::function<void(const std::string &id, const std::string &request)>;
+        // Returns the JSON result right away.
+        using SyncBinding = std::function<std::string(const std::string &request)>;
+
+        WebviewBackend() = default;
+
+        virtual ~WebviewBackend() = default;
+
+        WebviewBackend(const WebviewBackend &) = delete;
+        WebviewBackend &operator=(const WebviewBackend &) = delete;
+
+        virtual void setTitle(const std::string &title) = 0;
+
+        virtual void setSize(int width, int height) = 0;
+
+        virtual void setHtml(const std::string &html) = 0;
+
+        // Script run before any page script on every page load.
+        virtual void init(const std::string &script) = 0;
+
+        virtual void eval(const std::string &script) = 0;
+
+        virtual void bind(const std::string &name, Binding binding) = 0;
+
+        virtual void unbind(const std::string &name) = 0;
+
+        // Settles the page's promise for a binding call; status 0 resolves, anything else rejects.
+        virtual void resolve(const std::string &id, int status, const std::string &result) = 0;
+
+        // Runs task on the UI thread.
+        virtual void dispatch(std::function<void()> task) = 0;
+
+        virtual void run() = 0;
+
+        virtual void terminate() = 0;
+
+        void bind(const std::string &name, SyncBinding binding) {
+            bind(name, [this, binding = std::move(binding)](const std::string &id, const std::string &request) {
+                resolve(id, 0, binding(request));
+            });
+        }
+    };
+
+    class NativeWebviewBackend final : public WebviewBackend {
+        webview::webview webview_;
+
+    public:
+        explicit NativeWebviewBackend(const bool debug = true, void *window = nullptr) : webview_(debug, window) {
+        }
+
+        void setTitle(const std::string &title) override {
+            webview_.set_title(title);
+        }
+
+        void setSize(const int width, const int height) override {
+            webview_.set_size(width, height, WEBVIEW_HINT_NONE);
+        }
+
+        void setHtml(const std::string &html) override {
+            webview_.set_html(html);
+        }
+
+        void init(const std::string &script) override {
+            webview_.init(script);
+        }
+
+        void eval(const std::string &script) override {
+            webview_.eval(script);
+        }
+
+        using WebviewBackend::bind;
+
+        void bind(const std::string &name, Binding binding) override {
+            webview_.bind(name, [binding = std::move(binding)](const std::string &id, const std::string &request,
+                                                               void * /*arg*/) {
+                binding(id, request);
+            }, nullptr);
+        }
+
+        void unbind(const std::string &name) override {
+            webview_.unbind(name);
+        }
+
+        void resolve(const std::string &id, const int status, const std::string &result) override {
+            webview_.resolve(id, status, result);
+        }
+
+        void dispatch(std::function<void()> task) override {
+            webview_.dispatch(std::move(task));
+        }
+
+        void run() override {
+            webview_.run();
+        }
+
+        void terminate() override {
+            webview_.terminate();
+        }
+
+        [[nodiscard]] webview::webview &getWebview() {
+            return webview_;
+        }
+    };
+}
+
+#endif //WEBVIEWBACKEND_HPP
@@ -1,4 +1,12 @@
+#pragma once
+
+#ifndef WIDGETEDSL_HPP
+#define WIDGETEDSL_HPP
+
+#include <cstdint>
 #include <iostream>
+#include <tuple>
+#include <type_traits>
 #include <boost/proto/proto.hpp>
 #include <boost/typeof/std/ostream.hpp>
 
@@ -11,6 +19,10 @@ namespace groklab {
     struct placeholder
     {};
 
+    // Terminal for placeholder I, e.g. (arg<1> - arg<0>) / arg<1> * 100.
+    template<int I>
+    inline const typename proto::terminal<placeholder<I> >::type arg = {{}};
+
     template<typename Expr>
     void evaluate(Expr const &expr) {
         proto::default_context ctx;
@@ -21,4 +33,263 @@ namespace groklab {
     void print_expr_tree(Expr const &expr) {
         proto::display_expr(expr);
     }
-}
\ No newline at end of file
+
+    // Fields of a state struct that reactive expressions read; placeholder<I> stands for the I-th one.
+    //     using Fields = StateFields<&Stats::previous, &Stats::current>;
+    template<auto... Fields>
+    struct StateFields {
+    private:
+        template<typename Value, typename Class>
+        static Class classOf(Value Class::*);
+
+        template<auto A, auto B>
+        static constexpr bool isSame() {
+            if constexpr (std::is_same_v<decltype(A), decltype(B)>) {
+                return A == B;
+            } else {
+                return false;
+            }
+        }
+
+    public:
+        static constexpr size_t kCount = sizeof...(Fields);
+        static_assert(kCount > 0 && kCount <= 64, "StateFields takes 1 to 64 fields");
+
+        using State = decltype(classOf(std::get<0>(std::tuple{Fields...})));
+        static_assert((std::is_same_v<State, decltype(classOf(Fields))> && ...),
+                      "StateFields must all be members of one struct");
+
+        template<int I>
+        static const auto &get(const State &state) {
+            return state.*std::get<I>(std::tuple{Fields...});
+        }
+
+        // Change bit of a field, as tested against ReactiveExpression::kDependencies.
+        template<auto Field>
+        static constexpr uint64_t bit() {
+            uint64_t mask = 0;
+            uint64_t index = 0;
+            ((mask |= isSame<Field, Fields>() ? uint64_t{1} << index : 0, ++index), ...);
+            return mask;
+        }
+    };
+
+    namespace reactive {
+        template<typename T>
+        struct IsNumber : std::is_arithmetic<std::remove_cvref_t<T> > {
+        };
+
+        template<typename T>
+        struct IsPlaceholderValue : std::false_type {
+        };
+
+        template<int I>
+        struct IsPlaceholderValue<placeholder<I> > : std::true_type {
+        };
+
+        template<typename T>
+        struct IsPlaceholder : IsPlaceholderValue<std::remove_cvref_t<T> > {
+        };
+
+        struct Placeholder : proto::and_<proto::terminal<proto::_>, proto::if_<IsPlaceholder<proto::_value>()> > {
+        };
+
+        // Arithmetic, comparison, logical and conditional expressions over placeholders and number literals.
+        struct Grammar : proto::or_<
+                    Placeholder,
+                    proto::and_<proto::terminal<proto::_>, proto::if_<IsNumber<proto::_value>()> >,
+                    proto::or_<
+                        proto::negate<Grammar>,
+                        proto::unary_plus<Grammar>,
+                        proto::logical_not<Grammar> >,
+                    proto::or_<
+                        proto::plus<Grammar, Grammar>,
+                        proto::minus<Grammar, Grammar>,
+                        proto::multiplies<Grammar, Grammar>,
+                        proto::divides<Grammar, Grammar>,
+                        proto::modulus<Grammar, Grammar> >,
+                    proto::or_<
+                        proto::less<Grammar, Grammar>,
+                        proto::less_equal<Grammar, Grammar>,
+                        proto::greater<Grammar, Grammar>,
+                        proto::greater_equal<Grammar, Grammar>,
+                        proto::equal_to<Grammar, Grammar>,
+                        proto::not_equal_to<Grammar, Grammar> >,
+                    proto::logical_and<Grammar, Grammar>,
+                    proto::logical_or<Grammar, Grammar>,
+                    proto::if_else_<Grammar, Grammar, Grammar> > {
+        };
+
+        // Reads placeholder<I> from the FieldAccess passed as the transform state.
+        struct ReadField : proto::callable {
+            template<typename Signature>
+            struct result;
+
+            template<typename This, typename Value, typename Access>
+            struct result<This(Value, Access)> {
+                using type = decltype(std::declval<const ReadField &>()(std::declval<Value>(),
+                                                                        std::declval<Access>()));
+            };
+
+            template<int I, typename Access>
+            decltype(auto) operator()(placeholder<I>, const Access &access) const {
+                return access.template get<I>();
+            }
+        };
+
+        // Evaluates an expression matching Grammar; every operator maps to the C++ operator on its operands.
+        struct Evaluate : proto::or_<
+                    proto::when<Placeholder, ReadField(proto::_value, proto::_state)>,
+                    proto::when<proto::terminal<proto::_>, proto::_value>,
+                    proto::otherwise<proto::_default<Evaluate> > > {
+        };
+
+        template<typename T>
+        struct PlaceholderBit : std::integral_constant<uint64_t, 0> {
+        };
+
+        template<int I>
+        struct PlaceholderBit<placeholder<I> > : std::integral_constant<uint64_t, uint64_t{1} << I> {
+        };
+
+        template<typename T>
+        struct TerminalMask : PlaceholderBit<std::remove_cvref_t<T> > {
+        };
+
+        template<typename A, typename B>
+        struct MaskUnion : std::integral_constant<uint64_t,
+                    std::remove_cvref_t<A>::value | std::remove_cvref_t<B>::value> {
+        };
+
+        // Computes, as a std::integral_constant, the bit mask of the placeholders an expression reads.
+        struct Dependencies : proto::or_<
+                    proto::when<proto::terminal<proto::_>, TerminalMask<proto::_value>()>,
+                    proto::when<proto::nary_expr<proto::_, proto::vararg<proto::_> >,
+                        proto::fold<proto::_, std::integral_constant<uint64_t, 0>(),
+                            MaskUnion<Dependencies, proto::_state>()> > > {
+        };
+
+        template<typename Fields>
+        struct FieldAccess {
+            const typename Fields::State &state;
+
+            template<int I>
+            [[nodiscard]] const auto &get() const {
+                return Fields::template get<I>(state);
+            }
+        };
+    }
+
+    // Compiled reactive expression over the fields of a state struct. Evaluation walks the expression type with
+    // the reactive::Evaluate transform, so after inlining it is the plain arithmetic on the fields; kDependencies
+    // is the mask of fields it reads, known at compile time.
+    template<typename Fields, typename Expr>
+    class ReactiveExpression {
+        Expr expr_;
+
+    public:
+        using State = typename Fields::State;
+        using Value = std::decay_t<decltype(reactive::Evaluate()(std::declval<const Expr &>(),
+                                                                 std::declval<reactive::FieldAccess<Fields> &>()))>;
+
+        static constexpr uint64_t kDependencies =
+                std::remove_cvref_t<decltype(reactive::Dependencies()(std::declval<const Expr &>()))>::value;
+        static_assert(Fields::kCount == 64 || (kDependencies >> Fields::kCount) == 0,
+                      "Expression uses a placeholder beyond the given StateFields");
+
+        explicit ReactiveExpression(Expr expr) : expr_(std::move(expr)) {
+        }
+
+        Value operator()(const State &state) const {
+            reactive::FieldAccess<Fields> access{state};
+            return reactive::Evaluate()(expr_, access);
+        }
+
+        template<auto Field>
+        static constexpr bool dependsOn() {
+            return (kDependencies & Fields::template bit<Field>()) != 0;
+        }
+    };
+
+    // Checks expr against reactive::Grammar and compiles it for the given fields. The expression is deep copied,
+    // so the result outlives the temporaries it was built from; pass it straight in rather than storing it in an
+    // auto variable first, which would already hold dangling references to those temporaries.
+    //     auto growth = compile<Fields>((arg<1> - arg<0>) / arg<1> * 100);
+    template<typename Fields, typename Expr>
+    auto compile(const Expr &expr) {
+        static_assert(proto::matches<Expr, reactive::Grammar>::value,
+                      "Not a reactive expression: use placeholders, numbers and arithmetic or logical operators");
+        using Copy = typename proto::result_of::deep_copy<Expr>::type;
+        return ReactiveExpression<Fields, Copy>(proto::deep_copy(expr));
+    }
+
+    // State struct that records which fields changed since the last takeChanges().
+    template<typename Fields>
+    class ReactiveState {
+        using State = typename Fields::State;
+
+        State state_{};
+        // Everything counts as changed until the first takeChanges().
+        uint64_t changed_{~uint64_t{0}};
+
+    public:
+        ReactiveState() = default;
+
+        explicit ReactiveState(State state) : state_(std::move(state)) {
+        }
+
+        template<auto Field, typename Value>
+        void set(Value &&value) {
+            auto &slot = state_.*Field;
+            if (!(slot == value)) {
+                slot = std::forward<Value>(value);
+                changed_ |= Fields::template bit<Field>();
+            }
+        }
+
+        [[nodiscard]] const State &get() const {
+            return state_;
+        }
+
+        uint64_t takeChanges() {
+            return std::exchange(changed_, 0);
+        }
+    };
+
+    // Cached value of a ReactiveExpression, recomputed only when a field it reads has changed.
+    template<typename Expression>
+    class Computed {
+        Expression expression_;
+        typename Expression::Value value_{};
+        bool valid_{false};
+        size_t evaluations_{0};
+
+    public:
+        explicit Computed(Expression expression) : expression_(std::move(expression)) {
+        }
+
+        // changed is a mask of StateFields bits, e.g. from ReactiveState::takeChanges(). Returns true if the
+        // value was recomputed and differs from the previous one.
+        bool update(const typename Expression::State &state, const uint64_t changed) {
+            if (valid_ && (changed & Expression::kDependencies) == 0) {
+                return false;
+            }
+            ++evaluations_;
+            auto value = expression_(state);
+            const bool differs = !valid_ || !(value == value_);
+            value_ = std::move(value);
+            valid_ = true;
+            return differs;
+        }
+
+        [[nodiscard]] const typename Expression::Value &get() const {
+            return value_;
+        }
+
+        [[nodiscard]] size_t getEvaluationCount() const {
+            return evaluations_;
+        }
+    };
+}
+
+#endif //WIDGETEDSL_HPP
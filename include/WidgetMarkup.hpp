@@ -0,0 +1,123 @@
+#pragma once
+
+#ifndef WIDGETMARKUP_HPP
+#define WIDGETMARKUP_HPP
+
+#include <array>
+#include <string>
+#include <string_view>
+#include "WidgetStore.hpp"
+
+namespace groklab {
+    // Markup of a single widget, shared by the generators that walk the widget tree.
+    struct WidgetMarkup {
+        // Attribute holding a widget's text content; Html widgets hold raw markup in kHtmlAttribute.
+        static constexpr std::string_view kTextAttribute = "text";
+        static constexpr std::string_view kHtmlAttribute = "html";
+
+        // Appends text with &, <, >, " and ' replaced by character references. Runs without special characters
+        // are copied in one go.
+        static void appendEscaped(std::string &out, const std::string_view text) {
+            static constexpr std::array<bool, 256> kSpecial = [] {
+                std::array<bool, 256> special{};
+                for (const unsigned char c: std::string_view("&<>\"'")) {
+                    special[c] = true;
+                }
+                return special;
+            }();
+            size_t run = 0;
+            for (size_t i = 0; i < text.size(); ++i) {
+                const auto c = static_cast<unsigned char>(text[i]);
+                if (!kSpecial[c]) {
+                    continue;
+                }
+                out.append(text.substr(run, i - run));
+                switch (c) {
+                    case '&': out.append("&amp;"); break;
+                    case '<': out.append("&lt;"); break;
+                    case '>': out.append("&gt;"); break;
+                    case '"': out.append("&quot;"); break;
+                    default: out.append("&#39;"); break;
+                }
+                run = i + 1;
+            }
+            out.append(text.substr(run));
+        }
+
+        static std::string_view tagOf(const Widget::WidgetType type) {
+            switch (type) {
+                case Widget::WidgetType::TextElement:
+                case Widget::WidgetType::Span:
+                    return "span";
+                case Widget::WidgetType::Label:
+                    return "label";
+                case Widget::WidgetType::Paragraph:
+                    return "p";
+                case Widget::WidgetType::Link:
+                    return "a";
+                default:
+                    return "div";
+            }
+        }
+
+        // Opening tag with the widget's id and attributes, followed by its text. store may be null for widgets
+        // that were never added to one; extra is inserted into the tag verbatim.
+        static void openTag(const Widget::WidgetType type, const bool visible, const WidgetStore *store,
+                            const WidgetId widget, std::string &out, const std::string_view extra = {}) {
+            out.push_back('<');
+            out.append(tagOf(type));
+            if (const std::string_view id = store == nullptr ? std::string_view{} : store->getId(widget);
+                !id.empty()) {
+                out.append(" id=\"");
+                appendEscaped(out, id);
+                out.push_back('"');
+            }
+            if (type == Widget::WidgetType::Layout) {
+                out.append(" class=\"fluid-layout\"");
+            } else if (type == Widget::WidgetType::Markdown) {
+                out.append(" class=\"fluid-markdown\"");
+            }
+            if (!visible) {
+                out.append(" hidden");
+            }
+            out.append(extra);
+            std::string_view content;
+            bool raw = false;
+            if (store != nullptr) {
+                store->forEachAttribute(widget, [&](const AttributeKey key, const std::string_view value) {
+                    const std::string_view name = store->getKeyName(key);
+                    if (name == kTextAttribute) {
+                        content = value;
+                    } else if (name == kHtmlAttribute && type == Widget::WidgetType::Html) {
+                        content = value;
+                        raw = true;
+                    } else {
+                        out.push_back(' ');
+                        out.append(name);
+                        out.append("=\"");
+                        appendEscaped(out, value);
+                        out.push_back('"');
+                    }
+                });
+            }
+            out.push_back('>');
+            if (raw) {
+                out.append(content);
+            } else {
+                appendEscaped(out, content);
+            }
+        }
+
+        static void openTag(const Widget &widget, std::string &out) {
+            openTag(widget.type, widget.isVisible(), widget.store, static_cast<WidgetId>(widget.nodeId), out);
+        }
+
+        static void closeTag(const Widget::WidgetType type, std::string &out) {
+            out.append("</");
+            out.append(tagOf(type));
+            out.push_back('>');
+        }
+    };
+}
+
+#endif //WIDGETMARKUP_HPP
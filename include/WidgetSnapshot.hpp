@@ -0,0 +1,351 @@
+#pragma once
+
+#ifndef WIDGETSNAPSHOT_HPP
+#define WIDGETSNAPSHOT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <graaflib/graph.h>
+
+#include "FileUtils.hpp"
+#include "Log.hpp"
+#include "MappedFile.hpp"
+#include "WidgetStore.hpp"
+
+namespace groklab {
+    // Binary snapshot of a widget tree: the WidgetStore with its interned attribute names, ids, attributes and
+    // topology, plus the edges of the widget graph. Restoring maps the file and points the store's strings into
+    // the mapping, which the store keeps alive, so no string is copied; the fixed-size tables are copied in one
+    // block each. The graph is rebuilt from the store, as graaf keeps its vertices in node-based containers.
+    //
+    // Layout: Header, key spans, widget entries, four topology arrays (parents, first children, last children,
+    // next siblings), attribute entries, edge entries, then the string bytes the spans point at. All offsets are
+    // from the start of the file. A snapshot with a different magic or version is ignored.
+    class WidgetSnapshot {
+        static constexpr std::array<char, 4> kMagic{'F', 'G', 'W', 'S'};
+        static constexpr uint32_t kVersion = 1;
+
+        struct Header {
+            std::array<char, 4> magic{};
+            uint32_t version{0};
+            uint32_t widgetCount{0};
+            uint32_t keyCount{0};
+            uint32_t attributeCount{0};
+            uint32_t edgeCount{0};
+            uint64_t fileSize{0};
+        };
+
+        struct Span {
+            uint32_t offset{0};
+            uint32_t length{0};
+        };
+
+        struct WidgetEntry {
+            Span id;
+            uint32_t firstAttribute{0};
+            uint32_t attributeCount{0};
+            uint8_t type{0};
+            uint8_t visible{1};
+            uint8_t reserved[2]{};
+        };
+
+        struct AttributeEntry {
+            Span value;
+            AttributeKey key{0};
+        };
+
+        struct EdgeEntry {
+            uint32_t from{0};
+            uint32_t to{0};
+            uint32_t visible{1};
+        };
+
+        // Byte offsets of the tables, derived from the counts in the header.
+        struct Layout {
+            size_t keys;
+            size_t widgets;
+            size_t topology;
+            size_t attributes;
+            size_t edges;
+            size_t strings;
+
+            explicit Layout(const Header &header) {
+                keys = sizeof(Header);
+                widgets = keys + header.keyCount * sizeof(Span);
+                topology = widgets + header.widgetCount * sizeof(WidgetEntry);
+                attributes = topology + 4 * header.widgetCount * sizeof(WidgetId);
+                edges = attributes + header.attributeCount * sizeof(AttributeEntry);
+                strings = edges + header.edgeCount * sizeof(EdgeEntry);
+            }
+        };
+
+    public:
+        // Writes the snapshot next to path and renames it into place, so readers never see a partial file.
+        template<typename Vertex, typename Edge>
+        static bool write(const std::filesystem::path &path, const WidgetStore &store,
+                          const graaf::directed_graph<Vertex, Edge> &graph) {
+            Header header;
+            header.magic = kMagic;
+            header.version = kVersion;
+            header.widgetCount = static_cast<uint32_t>(store.size());
+            header.keyCount = static_cast<uint32_t>(store.keyNames_.size());
+
+            std::vector<EdgeEntry> edges;
+            edges.reserve(graph.edge_count());
+            for (const auto &[edgeId, edge]: graph.get_edges()) {
+                edges.push_back({static_cast<uint32_t>(edgeId.first), static_cast<uint32_t>(edgeId.second),
+                                 isVisible(edge) ? 1u : 0u});
+            }
+            std::sort(edges.begin(), edges.end(), [](const EdgeEntry &a, const EdgeEntry &b) {
+                return a.from != b.from ? a.from < b.from : a.to < b.to;
+            });
+            header.edgeCount = static_cast<uint32_t>(edges.size());
+
+            size_t attributeCount = 0;
+            for (WidgetId widget = 0; widget < store.size(); ++widget) {
+                store.forEachAttribute(widget, [&](AttributeKey, std::string_view) { ++attributeCount; });
+            }
+            header.attributeCount = static_cast<uint32_t>(attributeCount);
+
+            const Layout layout(header);
+            std::string strings;
+            bool overflow = false;
+            auto addString = [&](const std::string_view text) -> Span {
+                const size_t offset = layout.strings + strings.size();
+                if (offset + text.size() > std::numeric_limits<uint32_t>::max()) {
+                    overflow = true;
+                    return {};
+                }
+                strings.append(text);
+                return {static_cast<uint32_t>(offset), static_cast<uint32_t>(text.size())};
+            };
+
+            std::vector<Span> keys;
+            keys.reserve(header.keyCount);
+            for (const std::string_view name: store.keyNames_) {
+                keys.push_back(addString(name));
+            }
+            std::vector<WidgetEntry> widgets;
+            widgets.reserve(header.widgetCount);
+            std::vector<AttributeEntry> attributes;
+            attributes.reserve(attributeCount);
+            for (WidgetId widget = 0; widget < store.size(); ++widget) {
+                WidgetEntry &entry = widgets.emplace_back();
+                entry.id = addString(store.getId(widget));
+                entry.firstAttribute = static_cast<uint32_t>(attributes.size());
+                entry.type = static_cast<uint8_t>(store.getType(widget));
+                entry.visible = store.isVisible(widget) ? 1 : 0;
+                store.forEachAttribute(widget, [&](const AttributeKey key, const std::string_view value) {
+                    attributes.push_back({addString(value), key});
+                });
+                entry.attributeCount = static_cast<uint32_t>(attributes.size()) - entry.firstAttribute;
+            }
+            if (overflow) {
+                error("Widget snapshot {} would exceed 4 GiB", path.string());
+                return false;
+            }
+            header.fileSize = layout.strings + strings.size();
+
+            const std::filesystem::path tmpPath = path.string() + "." + FileUtils::generateRandomString(8) + ".tmp";
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) {
+                    error("Could not write widget snapshot {}", tmpPath.string());
+                    return false;
+                }
+                auto writeTable = [&file](const auto &table) {
+                    file.write(reinterpret_cast<const char *>(table.data()),
+                               static_cast<std::streamsize>(table.size() * sizeof(table[0])));
+                };
+                file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+                writeTable(keys);
+                writeTable(widgets);
+                writeTable(store.parents_);
+                writeTable(store.firstChildren_);
+                writeTable(store.lastChildren_);
+                writeTable(store.nextSiblings_);
+                writeTable(attributes);
+                writeTable(edges);
+                file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+                if (!file.good()) {
+                    error("Failed writing widget snapshot {}", tmpPath.string());
+                    file.close();
+                    std::error_code ec;
+                    std::filesystem::remove(tmpPath, ec);
+                    return false;
+                }
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmpPath, path, ec);
+            if (ec) {
+                error("Failed to publish widget snapshot {}: {}", path.string(), ec.message());
+                std::filesystem::remove(tmpPath, ec);
+                return false;
+            }
+            return true;
+        }
+
+        // Replaces the contents of store and graph with the snapshot at path. Returns false and leaves both
+        // untouched if the file is missing, from another version or damaged.
+        template<typename Vertex, typename Edge>
+        static bool restore(const std::filesystem::path &path, WidgetStore &store,
+                            graaf::directed_graph<Vertex, Edge> &graph) {
+            std::shared_ptr<const MappedFile> mapping = mapSnapshot(path);
+            if (mapping == nullptr) {
+                return false;
+            }
+            Header header;
+            if (mapping->size() < sizeof(Header)) {
+                warn("Ignoring truncated widget snapshot {}", path.string());
+                return false;
+            }
+            std::memcpy(&header, mapping->data(), sizeof(Header));
+            if (header.magic != kMagic || header.version != kVersion) {
+                warn("Ignoring widget snapshot {} of another format version", path.string());
+                return false;
+            }
+            const Layout layout(header);
+            if (header.fileSize != mapping->size() || layout.strings > mapping->size() || !isValid(*mapping, header)) {
+                warn("Discarding corrupt widget snapshot {}", path.string());
+                return false;
+            }
+
+            const char *base = mapping->data();
+            auto view = [base](const Span &span) { return std::string_view(base + span.offset, span.length); };
+            store.clear();
+            store.reserve(header.widgetCount);
+
+            store.keyNames_.reserve(header.keyCount);
+            for (uint32_t key = 0; key < header.keyCount; ++key) {
+                store.keyNames_.push_back(view(read<Span>(base, layout.keys, key)));
+                store.keys_.emplace(store.keyNames_.back(), key);
+            }
+
+            for (uint32_t widget = 0; widget < header.widgetCount; ++widget) {
+                const auto entry = read<WidgetEntry>(base, layout.widgets, widget);
+                WidgetStore::Record &record = store.records_.emplace_back();
+                record.idData = base + entry.id.offset;
+                record.idLength = entry.id.length;
+                record.type = static_cast<Widget::WidgetType>(entry.type);
+                record.visible = entry.visible != 0;
+                for (uint32_t i = 0; i < entry.attributeCount; ++i) {
+                    const auto attribute = read<AttributeEntry>(base, layout.attributes, entry.firstAttribute + i);
+                    const WidgetStore::Attribute stored{attribute.key, attribute.value.length,
+                                                        base + attribute.value.offset};
+                    if (record.inlineCount < WidgetStore::kInlineAttributes) {
+                        record.attributes[record.inlineCount++] = stored;
+                        continue;
+                    }
+                    if (record.overflow == UINT32_MAX) {
+                        record.overflow = static_cast<uint32_t>(store.overflow_.size());
+                        store.overflow_.emplace_back().reserve(entry.attributeCount - i);
+                    }
+                    store.overflow_[record.overflow].push_back(stored);
+                }
+            }
+
+            const size_t count = header.widgetCount;
+            size_t offset = layout.topology;
+            for (auto *table: {&store.parents_, &store.firstChildren_, &store.lastChildren_, &store.nextSiblings_}) {
+                table->resize(count);
+                std::memcpy(table->data(), base + offset, count * sizeof(WidgetId));
+                offset += count * sizeof(WidgetId);
+            }
+            store.backing_ = mapping;
+
+            graph = {};
+            for (WidgetId widget = 0; widget < count; ++widget) {
+                graph.add_vertex(store.makeWidget(widget));
+            }
+            for (uint32_t i = 0; i < header.edgeCount; ++i) {
+                const auto edge = read<EdgeEntry>(base, layout.edges, i);
+                graph.add_edge(edge.from, edge.to, Edge{edge.visible != 0});
+            }
+            return true;
+        }
+
+    private:
+        template<typename T>
+        static T read(const char *base, const size_t table, const size_t index) {
+            T value;
+            std::memcpy(&value, base + table + index * sizeof(T), sizeof(T));
+            return value;
+        }
+
+        template<typename Edge>
+        static bool isVisible(const Edge &edge) {
+            if constexpr (requires { edge->visible; }) {
+                return edge->visible;
+            } else {
+                return edge.visible;
+            }
+        }
+
+        static std::shared_ptr<const MappedFile> mapSnapshot(const std::filesystem::path &path) {
+            std::error_code ec;
+            if (!std::filesystem::exists(path, ec)) {
+                return nullptr;
+            }
+            try {
+                return std::make_shared<const MappedFile>(path);
+            } catch (const std::runtime_error &) {
+                return nullptr;
+            }
+        }
+
+        // Checks every span, key and widget index before the store is touched.
+        static bool isValid(const MappedFile &mapping, const Header &header) {
+            const Layout layout(header);
+            const char *base = mapping.data();
+            const size_t size = mapping.size();
+            auto validSpan = [&](const Span &span) {
+                return span.offset >= layout.strings && static_cast<size_t>(span.offset) + span.length <= size;
+            };
+            auto validWidget = [&](const WidgetId widget) {
+                return widget == kNoWidget || widget < header.widgetCount;
+            };
+            for (uint32_t key = 0; key < header.keyCount; ++key) {
+                if (!validSpan(read<Span>(base, layout.keys, key))) {
+                    return false;
+                }
+            }
+            for (uint32_t widget = 0; widget < header.widgetCount; ++widget) {
+                const auto entry = read<WidgetEntry>(base, layout.widgets, widget);
+                if (!validSpan(entry.id) || entry.type > static_cast<uint8_t>(Widget::WidgetType::Html) ||
+                    static_cast<size_t>(entry.firstAttribute) + entry.attributeCount > header.attributeCount) {
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < 4 * static_cast<size_t>(header.widgetCount); ++i) {
+                if (!validWidget(read<WidgetId>(base, layout.topology, i))) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < header.attributeCount; ++i) {
+                const auto attribute = read<AttributeEntry>(base, layout.attributes, i);
+                if (!validSpan(attribute.value) || attribute.key >= header.keyCount) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < header.edgeCount; ++i) {
+                const auto edge = read<EdgeEntry>(base, layout.edges, i);
+                if (edge.from >= header.widgetCount || edge.to >= header.widgetCount) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+}
+
+#endif //WIDGETSNAPSHOT_HPP
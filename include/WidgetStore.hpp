@@ -0,0 +1,418 @@
+#pragma once
+
+#ifndef WIDGETSTORE_HPP
+#define WIDGETSTORE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <graaflib/graph.h>
+
+namespace groklab {
+    class WidgetStore;
+    class WidgetSnapshot;
+
+    // Index of a widget in its WidgetStore. FluidUI keeps these equal to the widget's graaf vertex id.
+    using WidgetId = uint32_t;
+    // Interned attribute name, see WidgetStore::intern().
+    using AttributeKey = uint32_t;
+
+    inline constexpr WidgetId kNoWidget = UINT32_MAX;
+    inline constexpr AttributeKey kNoAttributeKey = UINT32_MAX;
+
+    // Graph vertex of a widget. Its id and attributes live in the owning WidgetStore, so copies made by the graph
+    // are a few bytes and never allocate.
+    struct Widget {
+        enum class WidgetType : uint8_t {
+            Undefined,
+            Layout,
+            // Text elements
+            TextElement,
+            Label,
+            Paragraph,
+            Span,
+            Link,
+            Markdown,
+            Html,
+        };
+
+        enum class LayoutType : uint8_t {
+            Horizontal,
+            Vertical,
+        };
+
+        Widget() = default;
+
+        graaf::vertex_id_t nodeId{0};
+        WidgetStore *store{nullptr};
+        WidgetType type{WidgetType::Undefined};
+
+        [[nodiscard]] std::string_view getId() const;
+
+        // Visibility lives in the store, like the id and attributes, so layout and markup always agree on it.
+        [[nodiscard]] bool isVisible() const;
+
+        void setVisible(bool visible);
+
+        [[nodiscard]] std::string_view getAttribute(std::string_view key) const;
+
+        void setAttribute(std::string_view key, std::string_view value);
+
+        [[nodiscard]] bool hasAttribute(std::string_view key) const;
+    };
+
+    // Bump allocator for string data that lives as long as its owner. Returned views stay valid until clear().
+    class StringArena {
+        static constexpr size_t kBlockSize = 64 * 1024;
+
+        std::vector<std::unique_ptr<char[]> > blocks_;
+        char *cursor_{nullptr};
+        size_t remaining_{0};
+        size_t reserved_{0};
+        size_t used_{0};
+
+    public:
+        std::string_view store(const std::string_view text) {
+            if (text.empty()) {
+                return {};
+            }
+            char *dest;
+            if (text.size() > kBlockSize / 4) {
+                // Large strings get a block of their own instead of wasting the rest of the current one.
+                blocks_.push_back(std::make_unique_for_overwrite<char[]>(text.size()));
+                dest = blocks_.back().get();
+                reserved_ += text.size();
+            } else {
+                if (text.size() > remaining_) {
+                    blocks_.push_back(std::make_unique_for_overwrite<char[]>(kBlockSize));
+                    cursor_ = blocks_.back().get();
+                    remaining_ = kBlockSize;
+                    reserved_ += kBlockSize;
+                }
+                dest = cursor_;
+                cursor_ += text.size();
+                remaining_ -= text.size();
+            }
+            std::memcpy(dest, text.data(), text.size());
+            used_ += text.size();
+            return {dest, text.size()};
+        }
+
+        [[nodiscard]] size_t getReservedBytes() const {
+            return reserved_;
+        }
+
+        [[nodiscard]] size_t getUsedBytes() const {
+            return used_;
+        }
+
+        void clear() {
+            blocks_.clear();
+            cursor_ = nullptr;
+            remaining_ = reserved_ = used_ = 0;
+        }
+    };
+
+    // Compact storage for large widget trees. Widgets get dense ids in creation order; their ids and attribute
+    // values are copied into one StringArena, attribute names are interned once per store, and the first few
+    // attributes of a widget are stored inline, so a typical widget costs one fixed-size record and no heap
+    // allocation of its own. Children are kept in creation order as an intrusive sibling list.
+    //
+    // Replacing an attribute value leaves the old bytes in the arena until clear(); the store is built for trees
+    // that are mostly written once and read often.
+    class WidgetStore {
+    public:
+        static constexpr size_t kInlineAttributes = 3;
+
+    private:
+        struct Attribute {
+            AttributeKey key{kNoAttributeKey};
+            uint32_t length{0};
+            const char *data{nullptr};
+
+            [[nodiscard]] std::string_view value() const {
+                return {data, length};
+            }
+        };
+
+        struct Record {
+            const char *idData{nullptr};
+            uint32_t idLength{0};
+            Widget::WidgetType type{Widget::WidgetType::Undefined};
+            bool visible{true};
+            uint8_t inlineCount{0};
+            // Index into overflow_ once more than kInlineAttributes are set.
+            uint32_t overflow{UINT32_MAX};
+            Attribute attributes[kInlineAttributes];
+        };
+
+        std::vector<Record> records_;
+        // Topology in separate arrays, so traversals touch only what they need.
+        std::vector<WidgetId> parents_;
+        std::vector<WidgetId> firstChildren_;
+        std::vector<WidgetId> lastChildren_;
+        std::vector<WidgetId> nextSiblings_;
+        std::vector<std::vector<Attribute> > overflow_;
+        // Views into arena_.
+        std::unordered_map<std::string_view, AttributeKey> keys_;
+        std::vector<std::string_view> keyNames_;
+        StringArena arena_;
+        // Memory besides arena_ that ids, names and values may point into, e.g. a mapped WidgetSnapshot.
+        std::shared_ptr<const void> backing_;
+
+        friend class WidgetSnapshot;
+
+    public:
+        WidgetStore() = default;
+
+        WidgetStore(const WidgetStore &) = delete;
+        WidgetStore &operator=(const WidgetStore &) = delete;
+
+        void reserve(const size_t count) {
+            records_.reserve(count);
+            parents_.reserve(count);
+            firstChildren_.reserve(count);
+            lastChildren_.reserve(count);
+            nextSiblings_.reserve(count);
+        }
+
+        // Adds a widget as the last child of parent (or as a root) and returns its dense id.
+        WidgetId add(const Widget::WidgetType type, const std::string_view id, const WidgetId parent = kNoWidget) {
+            const auto widget = static_cast<WidgetId>(records_.size());
+            const std::string_view storedId = arena_.store(id);
+            Record &record = records_.emplace_back();
+            record.idData = storedId.data();
+            record.idLength = static_cast<uint32_t>(storedId.size());
+            record.type = type;
+            parents_.push_back(parent);
+            firstChildren_.push_back(kNoWidget);
+            lastChildren_.push_back(kNoWidget);
+            nextSiblings_.push_back(kNoWidget);
+            if (parent != kNoWidget) {
+                if (lastChildren_[parent] == kNoWidget) {
+                    firstChildren_[parent] = widget;
+                } else {
+                    nextSiblings_[lastChildren_[parent]] = widget;
+                }
+                lastChildren_[parent] = widget;
+            }
+            return widget;
+        }
+
+        // Widget value for the graph vertex of id.
+        [[nodiscard]] Widget makeWidget(const WidgetId id) {
+            Widget widget;
+            widget.nodeId = id;
+            widget.store = this;
+            widget.type = records_[id].type;
+            return widget;
+        }
+
+        AttributeKey intern(const std::string_view name) {
+            if (const auto it = keys_.find(name); it != keys_.end()) {
+                return it->second;
+            }
+            const auto key = static_cast<AttributeKey>(keyNames_.size());
+            keyNames_.push_back(arena_.store(name));
+            keys_.emplace(keyNames_.back(), key);
+            return key;
+        }
+
+        // kNoAttributeKey if no widget ever had an attribute of that name.
+        [[nodiscard]] AttributeKey findKey(const std::string_view name) const {
+            const auto it = keys_.find(name);
+            return it == keys_.end() ? kNoAttributeKey : it->second;
+        }
+
+        [[nodiscard]] std::string_view getKeyName(const AttributeKey key) const {
+            return keyNames_[key];
+        }
+
+        void setAttribute(const WidgetId id, const AttributeKey key, const std::string_view value) {
+            const std::string_view stored = arena_.store(value);
+            const Attribute attribute{key, static_cast<uint32_t>(stored.size()), stored.data()};
+            if (Attribute *existing = findAttribute(id, key)) {
+                *existing = attribute;
+                return;
+            }
+            Record &record = records_[id];
+            if (record.inlineCount < kInlineAttributes) {
+                record.attributes[record.inlineCount++] = attribute;
+                return;
+            }
+            if (record.overflow == UINT32_MAX) {
+                record.overflow = static_cast<uint32_t>(overflow_.size());
+                overflow_.emplace_back();
+            }
+            overflow_[record.overflow].push_back(attribute);
+        }
+
+        void setAttribute(const WidgetId id, const std::string_view name, const std::string_view value) {
+            setAttribute(id, intern(name), value);
+        }
+
+        [[nodiscard]] std::string_view getAttribute(const WidgetId id, const AttributeKey key) const {
+            const Attribute *attribute = findAttribute(id, key);
+            return attribute == nullptr ? std::string_view{} : attribute->value();
+        }
+
+        [[nodiscard]] std::string_view getAttribute(const WidgetId id, const std::string_view name) const {
+            const AttributeKey key = findKey(name);
+            return key == kNoAttributeKey ? std::string_view{} : getAttribute(id, key);
+        }
+
+        [[nodiscard]] bool hasAttribute(const WidgetId id, const std::string_view name) const {
+            const AttributeKey key = findKey(name);
+            return key != kNoAttributeKey && findAttribute(id, key) != nullptr;
+        }
+
+        // Calls fn(AttributeKey, std::string_view value) for every attribute of id, in the order they were added.
+        template<typename Fn>
+        void forEachAttribute(const WidgetId id, Fn &&fn) const {
+            const Record &record = records_[id];
+            for (uint8_t i = 0; i < record.inlineCount; ++i) {
+                fn(record.attributes[i].key, record.attributes[i].value());
+            }
+            if (record.overflow != UINT32_MAX) {
+                for (const Attribute &attribute: overflow_[record.overflow]) {
+                    fn(attribute.key, attribute.value());
+                }
+            }
+        }
+
+        [[nodiscard]] std::string_view getId(const WidgetId id) const {
+            return {records_[id].idData, records_[id].idLength};
+        }
+
+        [[nodiscard]] Widget::WidgetType getType(const WidgetId id) const {
+            return records_[id].type;
+        }
+
+        [[nodiscard]] bool isVisible(const WidgetId id) const {
+            return records_[id].visible;
+        }
+
+        void setVisible(const WidgetId id, const bool visible) {
+            records_[id].visible = visible;
+        }
+
+        [[nodiscard]] WidgetId getParent(const WidgetId id) const {
+            return parents_[id];
+        }
+
+        [[nodiscard]] WidgetId getFirstChild(const WidgetId id) const {
+            return firstChildren_[id];
+        }
+
+        [[nodiscard]] WidgetId getLastChild(const WidgetId id) const {
+            return lastChildren_[id];
+        }
+
+        [[nodiscard]] WidgetId getNextSibling(const WidgetId id) const {
+            return nextSiblings_[id];
+        }
+
+        // Calls fn(WidgetId) for the children of id in creation order.
+        template<typename Fn>
+        void forEachChild(const WidgetId id, Fn &&fn) const {
+            for (WidgetId child = firstChildren_[id]; child != kNoWidget; child = nextSiblings_[child]) {
+                fn(child);
+            }
+        }
+
+        [[nodiscard]] size_t size() const {
+            return records_.size();
+        }
+
+        [[nodiscard]] bool empty() const {
+            return records_.empty();
+        }
+
+        // Bytes held by the store, including arena blocks and container capacity.
+        [[nodiscard]] size_t getMemoryUsage() const {
+            size_t bytes = sizeof(*this) + arena_.getReservedBytes();
+            bytes += records_.capacity() * sizeof(Record);
+            bytes += (parents_.capacity() + firstChildren_.capacity() + lastChildren_.capacity() +
+                      nextSiblings_.capacity()) * sizeof(WidgetId);
+            bytes += overflow_.capacity() * sizeof(std::vector<Attribute>);
+            for (const auto &attributes: overflow_) {
+                bytes += attributes.capacity() * sizeof(Attribute);
+            }
+            bytes += keyNames_.capacity() * sizeof(std::string_view);
+            bytes += keys_.bucket_count() * sizeof(void *) +
+                     keys_.size() * (sizeof(std::string_view) + sizeof(AttributeKey) + 2 * sizeof(void *));
+            return bytes;
+        }
+
+        void clear() {
+            records_.clear();
+            parents_.clear();
+            firstChildren_.clear();
+            lastChildren_.clear();
+            nextSiblings_.clear();
+            overflow_.clear();
+            keys_.clear();
+            keyNames_.clear();
+            arena_.clear();
+            backing_.reset();
+        }
+
+    private:
+        Attribute *findAttribute(const WidgetId id, const AttributeKey key) {
+            return const_cast<Attribute *>(std::as_const(*this).findAttribute(id, key));
+        }
+
+        [[nodiscard]] const Attribute *findAttribute(const WidgetId id, const AttributeKey key) const {
+            const Record &record = records_[id];
+            for (uint8_t i = 0; i < record.inlineCount; ++i) {
+                if (record.attributes[i].key == key) {
+                    return &record.attributes[i];
+                }
+            }
+            if (record.overflow != UINT32_MAX) {
+                for (const Attribute &attribute: overflow_[record.overflow]) {
+                    if (attribute.key == key) {
+                        return &attribute;
+                    }
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    inline std::string_view Widget::getId() const {
+        return store == nullptr ? std::string_view{} : store->getId(static_cast<WidgetId>(nodeId));
+    }
+
+    inline bool Widget::isVisible() const {
+        return store == nullptr || store->isVisible(static_cast<WidgetId>(nodeId));
+    }
+
+    inline void Widget::setVisible(const bool visible) {
+        if (store != nullptr) {
+            store->setVisible(static_cast<WidgetId>(nodeId), visible);
+        }
+    }
+
+    inline std::string_view Widget::getAttribute(const std::string_view key) const {
+        return store == nullptr ? std::string_view{} : store->getAttribute(static_cast<WidgetId>(nodeId), key);
+    }
+
+    inline void Widget::setAttribute(const std::string_view key, const std::string_view value) {
+        if (store != nullptr) {
+            store->setAttribute(static_cast<WidgetId>(nodeId), key, value);
+        }
+    }
+
+    inline bool Widget::hasAttribute(const std::string_view key) const {
+        return store != nullptr && store->hasAttribute(static_cast<WidgetId>(nodeId), key);
+    }
+}
+
+#endif //WIDGETSTORE_HPP
@@ -1,27 +1,58 @@
 #include "webview/webview.h"
 
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <fstream>
 #include <sstream>
+#include <regex>
 
+#include "AsyncBindings.hpp"
+#include "BenchmarkUtils.hpp"
+#include "BridgeEncoding.hpp"
+#include "BridgeQueue.hpp"
 #include "Components.hpp"
 #include "HtmlUtility.hpp"
+#include "LayoutEngine.hpp"
 #include "ScreenUtils.hpp"
 #include "Log.hpp"
 #include "W2UIHtmlGenerator.hpp"
+#include "WidgetSnapshot.hpp"
+#include "WidgetStore.hpp"
 #include "UIDom.hpp"
 #include "WidgetEdsl.hpp"
+#include "SfcParser.hpp"
+#include "RenderPass.hpp"
+#include "RpcBindings.hpp"
+#include "StreamBindings.hpp"
+#include "ThreadPool.hpp"
+#include "ViewportCuller.hpp"
+#include "CallbackTable.hpp"
+#include "HeadlessWebviewBackend.hpp"
+#include "HtmlDiff.hpp"
 
 namespace gk = groklab;
 
+struct PriceState {
+  double previous = 0;
+  double current = 0;
+  double volume = 0;
+  int trades = 0;
+};
+
 void testEdsl() {
 
   static proto::terminal<gk::placeholder<0> >::type const _1 = {{}};
   static proto::terminal<gk::placeholder<1> >::type const _2 = {{}};
-  auto expr = (_2 - _1) / _2 * 100;
+  // Pass the whole expression to compile(): proto holds its operands by reference, so a stored expression would
+  // dangle once the intermediate temporaries are destroyed.
+  const auto growth = gk::compile<gk::StateFields<&PriceState::previous, &PriceState::current> >((_2 - _1) / _2 * 100);
+  gk::info("growth from 50 to 200: {}%", growth(PriceState{50, 200}));
   proto::terminal<int>::type i = {0};
   gk::print_expr_tree(i + 1);
   proto::literal<int> i1 = 0;
@@ -44,15 +75,733 @@ void testJavaScript() {
 
 }
 
+// The std::regex extraction Component used before SfcDescriptor, kept here as the benchmark baseline.
+std::string regexTagContent(const std::string &content, const std::string &tagName) {
+  const std::string pattern = "<" + tagName + R"(\b[^>]*>([\s\S]*?)</)" + tagName + ">";
+  const std::regex tagRegex(pattern, std::regex::icase);
+  if (std::smatch matches; std::regex_search(content, matches, tagRegex)) {
+    return matches[1].str();
+  }
+  return "";
+}
+
+std::string regexScriptContent(const std::string &content) {
+  const std::regex scriptRegex(R"(export\s+default\s+\{([\s\S]*?)\})", std::regex::icase);
+  if (std::smatch matches; std::regex_search(content, matches, scriptRegex)) {
+    return matches[1].str();
+  }
+  return "";
+}
+
+void benchSfcParser() {
+  const std::string content = gk::FileUtils::readFileAsString("./web/vue/TextDisplay.vue");
+  constexpr size_t iterations = 2000;
+
+  gk::BenchmarkUtils::run("sfc regex", iterations, [&] {
+    const std::string templ = regexTagContent(content, "template");
+    const std::string style = regexTagContent(content, "style");
+    const std::string script = regexScriptContent(content);
+    gk::BenchmarkUtils::doNotOptimize(templ.size() + style.size() + script.size());
+  });
+
+  gk::BenchmarkUtils::run("sfc scanner", iterations, [&] {
+    const gk::SfcDescriptor sfc(content);
+    const auto script = gk::SfcDescriptor::exportDefaultBody(sfc.getScriptContent());
+    gk::BenchmarkUtils::doNotOptimize(sfc.getTemplateContent().size() + sfc.getStyleBlocks().size() + script.size());
+  });
+}
+
+void benchComponentRegistry() {
+  constexpr size_t instances = 5000;
+  const std::filesystem::path vuePath("./web/vue/TextDisplay.vue");
+
+  gk::BenchmarkUtils::run("definition per instance", 1, [&] {
+    std::vector<std::shared_ptr<const gk::ComponentDefinition>> definitions;
+    definitions.reserve(instances);
+    for (size_t i = 0; i < instances; ++i) {
+      definitions.emplace_back(gk::ComponentDefinition::fromFile(vuePath));
+    }
+    gk::BenchmarkUtils::doNotOptimize(definitions.size());
+  });
+
+  gk::BenchmarkUtils::run("shared definition", 1, [&] {
+    std::vector<std::shared_ptr<gk::TextDisplay>> labels;
+    labels.reserve(instances);
+    for (size_t i = 0; i < instances; ++i) {
+      labels.emplace_back(std::make_shared<gk::TextDisplay>("Label", gk::TextSize::regular, gk::TextStyle::normal,
+                                                            gk::TextColor::black));
+    }
+    gk::BenchmarkUtils::doNotOptimize(labels.size());
+  });
+  gk::info("Registered component definitions: {}", gk::ComponentRegistry::instance().size());
+}
+
+void benchComponentCache() {
+  const std::filesystem::path vuePath("./web/vue/TextDisplay.vue");
+  gk::ComponentCache cache("./.fluid-cache");
+  cache.clear();
+
+  const auto cold = cache.load(vuePath);
+  const auto warm = cache.load(vuePath);
+  gk::info("Cached template of {} restored {} bytes, {} props", warm->getName(),
+           warm->getSerializedTemplate().size(), warm->getProps().size());
+  cache.logStats();
+
+  gk::BenchmarkUtils::run("component parse", 200, [&] {
+    const auto definition = gk::ComponentDefinition::fromFile(vuePath);
+    gk::BenchmarkUtils::doNotOptimize(definition->getSerializedTemplate().size());
+  });
+  gk::BenchmarkUtils::run("component cache warm load", 200, [&] {
+    const auto definition = cache.load(vuePath);
+    gk::BenchmarkUtils::doNotOptimize(definition->getSerializedTemplate().size());
+  });
+}
+
+class Dashboard final : public gk::Component<Dashboard> {
+public:
+  void compose() override {}
+};
+
+void benchIncrementalRender() {
+  constexpr size_t cells = 10000;
+  auto dashboard = std::make_shared<Dashboard>();
+  std::vector<std::shared_ptr<gk::TextDisplay>> labels;
+  labels.reserve(cells);
+  for (size_t i = 0; i < cells; ++i) {
+    labels.emplace_back(dashboard->addChild<gk::TextDisplay>(std::to_string(i), gk::TextSize::regular,
+                                                             gk::TextStyle::normal, gk::TextColor::black));
+  }
+
+  gk::RenderPass pass;
+  pass.run(*dashboard);
+  gk::info("Initial render: {} patches, {} bytes", pass.getPatchCount(), pass.getPatches().size());
+  pass.reset();
+
+  size_t tick = 0;
+  gk::BenchmarkUtils::run("incremental render of 10 changed cells", 1000, [&] {
+    for (size_t i = 0; i < 10; ++i) {
+      labels[(tick * 37 + i * 997) % cells]->setState("value", std::to_string(tick));
+    }
+    ++tick;
+    pass.run(*dashboard);
+    const std::string script = pass.takeScript();
+    gk::BenchmarkUtils::doNotOptimize(script.size());
+  });
+}
+
+void benchParallelRender() {
+  constexpr size_t sections = 100;
+  constexpr size_t cellsPerSection = 200;
+  auto dashboard = std::make_shared<Dashboard>();
+  std::vector<std::shared_ptr<gk::ComponentNode>> nodes;
+  for (size_t s = 0; s < sections; ++s) {
+    auto section = dashboard->addChild<Dashboard>();
+    nodes.push_back(section);
+    for (size_t c = 0; c < cellsPerSection; ++c) {
+      nodes.push_back(section->addChild<gk::TextDisplay>(std::to_string(c), gk::TextSize::regular,
+                                                         gk::TextStyle::normal, gk::TextColor::black));
+    }
+  }
+  const auto markAllDirty = [&] {
+    dashboard->markDirty();
+    for (const auto &node: nodes) {
+      node->markDirty();
+    }
+  };
+
+  gk::RenderPass serial;
+  markAllDirty();
+  serial.run(*dashboard);
+  const std::string expected = serial.takeScript();
+
+  gk::BenchmarkUtils::run("render serial", 20, [&] {
+    markAllDirty();
+    serial.run(*dashboard);
+    gk::BenchmarkUtils::doNotOptimize(serial.takeScript());
+  });
+
+  const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    gk::ThreadPool pool(threads);
+    gk::RenderPass parallel(gk::RenderMode::Parallel, &pool);
+    markAllDirty();
+    parallel.run(*dashboard);
+    if (parallel.takeScript() != expected) {
+      gk::error("Parallel render with {} threads differs from the serial render", threads);
+    }
+    gk::BenchmarkUtils::run(std::format("render parallel x{}", threads), 20, [&] {
+      markAllDirty();
+      parallel.run(*dashboard);
+      gk::BenchmarkUtils::doNotOptimize(parallel.takeScript());
+    });
+  }
+}
+
+void benchCallbackDispatch() {
+  constexpr size_t callbacks = 64;
+  constexpr size_t calls = 1000000;
+  std::vector<std::string> names;
+  for (size_t i = 0; i < callbacks; ++i) {
+    names.emplace_back(std::format("on_event_{}", i));
+  }
+
+  long total = 0;
+  std::map<std::string, std::function<void()>> functionMap;
+  gk::CallbackTable table;
+  for (size_t i = 0; i < callbacks; ++i) {
+    functionMap[names[i]] = [&total, i] { total += static_cast<long>(i); };
+    table.add(names[i], [&total](long value) { total += value; });
+  }
+  table.freeze();
+
+  gk::BenchmarkUtils::run("std::map<std::string, std::function>", 1, [&] {
+    for (size_t i = 0; i < calls; ++i) {
+      if (const auto it = functionMap.find(names[i % callbacks]); it != functionMap.end()) {
+        it->second();
+      }
+    }
+  });
+  gk::BenchmarkUtils::run("CallbackTable typed", 1, [&] {
+    for (size_t i = 0; i < calls; ++i) {
+      table.call(names[i % callbacks], static_cast<long>(i % callbacks));
+    }
+  });
+  gk::BenchmarkUtils::doNotOptimize(total);
+}
+
+void benchHtmlSerialization() {
+  const gk::HtmlUtility html(std::filesystem::path("./web/test.html"));
+  using Mode = gk::HtmlUtility::SerializeMode;
+  gk::info("Serialized size: pretty {} bytes, compact {} bytes", html.serializedSize(Mode::kPretty),
+           html.serializedSize(Mode::kCompact));
+
+  gk::BenchmarkUtils::run("html toString pretty", 500, [&] {
+    gk::BenchmarkUtils::doNotOptimize(html.toString(Mode::kPretty).size());
+  });
+  gk::BenchmarkUtils::run("html toString compact", 500, [&] {
+    gk::BenchmarkUtils::doNotOptimize(html.toString(Mode::kCompact).size());
+  });
+  gk::BenchmarkUtils::run("html writeToFile compact", 500, [&] {
+    html.writeToFile("./index-bench.html", Mode::kCompact);
+  });
+  std::filesystem::remove("./index-bench.html");
+}
+
+void benchSelectorQueries() {
+  const gk::HtmlUtility html(std::filesystem::path("./web/test.html"));
+  std::vector<lxb_dom_element_t *> results;
+  gk::info("div matches: {}", html.querySelectorAll("div", results).size());
+
+  gk::BenchmarkUtils::run("findElementsWithTagName div", 2000, [&] {
+    lxb_dom_collection_t *collection = html.findElementsWithTagName("div");
+    gk::BenchmarkUtils::doNotOptimize(lxb_dom_collection_length(collection));
+    lxb_dom_collection_destroy(collection, true);
+  });
+  gk::BenchmarkUtils::run("querySelectorAll div", 2000, [&] {
+    gk::BenchmarkUtils::doNotOptimize(html.querySelectorAll("div", results).size());
+  });
+  gk::BenchmarkUtils::run("querySelector q-app", 2000, [&] {
+    gk::BenchmarkUtils::doNotOptimize(html.querySelector("q-app"));
+  });
+}
+
+std::string makeTable(const size_t rows, const size_t revision) {
+  std::string html = "<html><head><title>Report</title></head><body><table><tbody>";
+  for (size_t row = 0; row < rows; ++row) {
+    // Every 97th row changes per revision, and the first two rows swap places.
+    const size_t id = row < 2 && revision % 2 == 1 ? 1 - row : row;
+    html += std::format("<tr id=\"row-{}\"><td>{}</td><td class=\"value\">{}</td><td>{}</td></tr>", id, id,
+                        id % 97 == 0 ? id * 10 + revision : id * 10, "static");
+  }
+  return html + "</tbody></table></body></html>";
+}
+
+void benchHtmlDiff() {
+  for (const size_t rows: {1'000, 10'000, 50'000}) {
+    const std::string before = makeTable(rows, 0);
+    const std::string after = makeTable(rows, 1);
+    const gk::HtmlUtility previous(before);
+    const gk::HtmlUtility next(after);
+
+    gk::HtmlDiff diff;
+    diff.diff(previous, next);
+    const std::string patch = diff.toJson();
+    gk::info("{} rows: {} ops, {} nodes compared, patch {} bytes vs {} bytes of HTML", rows, diff.getOps().size(),
+             diff.getVisitedCount(), patch.size(), after.size());
+
+    gk::BenchmarkUtils::run(std::format("html diff {} rows", rows), 20, [&] {
+      gk::BenchmarkUtils::doNotOptimize(diff.diff(previous, next).size());
+    });
+  }
+}
+
+void benchBatchSerialization() {
+  const gk::HtmlUtility html(makeTable(20'000, 0));
+  lxb_dom_collection_t *rows = html.findElementsWithTagName("tr");
+  gk::ThreadPool pool;
+  using Mode = gk::HtmlUtility::SerializeMode;
+  gk::info("Serializing {} rows", lxb_dom_collection_length(rows));
+
+  gk::BenchmarkUtils::run("lxbCollectionToString", 10, [&] {
+    gk::BenchmarkUtils::doNotOptimize(gk::HtmlUtility::lxbCollectionToString(rows).size());
+  });
+  gk::BenchmarkUtils::run("serializeCollection serial", 10, [&] {
+    gk::BenchmarkUtils::doNotOptimize(gk::HtmlUtility::serializeCollection(rows, Mode::kCompact).size());
+  });
+  gk::BenchmarkUtils::run(std::format("serializeCollection x{}", pool.size()), 10, [&] {
+    gk::BenchmarkUtils::doNotOptimize(gk::HtmlUtility::serializeCollection(rows, Mode::kCompact, &pool).size());
+  });
+  lxb_dom_collection_destroy(rows, true);
+}
+
+void benchBridgeQueue() {
+  gk::BridgeQueue queue;
+  gk::BenchmarkUtils::run("bridge 10k posts, 1k keys, one flush", 100, [&] {
+    for (int i = 0; i < 10'000; ++i) {
+      queue.post("state", std::to_string(i % 1'000), std::to_string(i));
+    }
+    gk::BenchmarkUtils::doNotOptimize(queue.takeScript().size());
+  });
+  gk::BenchmarkUtils::run("10k individual scripts", 100, [&] {
+    size_t bytes = 0;
+    for (int i = 0; i < 10'000; ++i) {
+      bytes += std::format("window.fluid.receive([[\"state\",\"{}\",{}]]);", i % 1'000, i).size();
+    }
+    gk::BenchmarkUtils::doNotOptimize(bytes);
+  });
+  const auto metrics = queue.getMetrics();
+  gk::info("Bridge: {} posted, {} merged, {} flushes, {:.1f} messages per flush, max latency {:.3f} ms",
+           metrics.postedCount, metrics.mergedCount, metrics.flushCount, metrics.averageFlushSize(),
+           metrics.maxFlushLatencyMs);
+}
+
+struct ChartSeries {
+  std::string name;
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<int64_t> counts;
+};
+
+void benchBridgeEncoding() {
+  ChartSeries series{"latency"};
+  for (int i = 0; i < 10'000; ++i) {
+    series.x.push_back(i * 0.001);
+    series.y.push_back(std::sin(i * 0.01) * 1'000.0);
+    series.counts.push_back(i * 7);
+  }
+  const std::string json = gk::BridgeCodec::toJson(series, gk::BridgeEncoding::kJson);
+  gk::BenchmarkUtils::run("json encode 10k point series", 100, [&] {
+    gk::BenchmarkUtils::doNotOptimize(gk::BridgeCodec::toJson(series, gk::BridgeEncoding::kJson).size());
+  });
+  gk::BenchmarkUtils::run("json decode 10k point series", 100, [&] {
+    gk::BenchmarkUtils::doNotOptimize(rfl::json::read<ChartSeries>(json).value().x.size());
+  });
+  gk::info("JSON: {} bytes on the wire", json.size());
+#ifdef FLUID_CBOR_BRIDGE
+  const auto cbor = rfl::cbor::write(series);
+  const std::string wire = gk::BridgeCodec::toJson(series, gk::BridgeEncoding::kCbor);
+  gk::BenchmarkUtils::run("cbor+base64 encode 10k point series", 100, [&] {
+    gk::BenchmarkUtils::doNotOptimize(gk::BridgeCodec::toJson(series, gk::BridgeEncoding::kCbor).size());
+  });
+  gk::BenchmarkUtils::run("cbor decode 10k point series", 100, [&] {
+    gk::BenchmarkUtils::doNotOptimize(rfl::cbor::read<ChartSeries>(cbor).value().x.size());
+  });
+  gk::info("CBOR: {} bytes, {} bytes on the wire as base64", cbor.size(), wire.size());
+#else
+  gk::info("Configure with -DFLUID_CBOR_BRIDGE=ON to compare against CBOR");
+#endif
+}
+
+// Serves fixed markup, so the headless benchmark measures the pipeline rather than file I/O.
+class StaticHtmlGenerator : public gk::HtmlGenerator {
+  std::string html_;
+
+public:
+  explicit StaticHtmlGenerator(std::string html) : html_(std::move(html)) {
+  }
+
+  [[nodiscard]] std::string generateHtml(const WidgetGraphType & /*widgetGraph*/) const override {
+    return html_;
+  }
+};
+
+void benchHeadlessPipeline() {
+  auto backend = std::make_unique<gk::HeadlessWebviewBackend>();
+  gk::HeadlessWebviewBackend &headless = *backend;
+  gk::FluidUI ui("Headless", 1280, 800, std::make_unique<StaticHtmlGenerator>(makeTable(1'000, 0)),
+                 std::move(backend));
+  gk::BenchmarkUtils::run("headless generate, 1k rows", 100, [&] {
+    ui.generate();
+  });
+  gk::BenchmarkUtils::run("headless typed rpc call", 10'000, [&] {
+    const std::string id = headless.call("count", R"([{"method":"bench"}])");
+    gk::BenchmarkUtils::doNotOptimize(headless.getResult(id)->value.size());
+  });
+  // Unpaced, so that runUntilIdle() finds the frame already dispatched.
+  ui.setFrameInterval({});
+  gk::BenchmarkUtils::run("headless 1k posts, one frame", 100, [&] {
+    for (int i = 0; i < 1'000; ++i) {
+      ui.post("state", std::to_string(i % 100), std::to_string(i));
+    }
+    headless.runUntilIdle();
+  });
+
+  // A steady producer against the default frame clock gets one flush per frame interval.
+  ui.setFrameInterval(gk::FrameClock::kDefaultInterval);
+  const auto before = ui.getBridgeMetrics();
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500); ++i) {
+    ui.post("state", std::to_string(i % 100), std::to_string(i));
+    headless.runUntilIdle();
+  }
+  headless.runUntilIdle();
+  const auto after = ui.getBridgeMetrics();
+  const size_t pacedFlushes = after.flushCount - before.flushCount;
+  gk::info("Paced producer: {} posts in {} flushes, {:.2f} ms average, {:.2f} ms last flush interval",
+           after.postedCount - before.postedCount, pacedFlushes,
+           pacedFlushes == 0 ? 0.0 : (after.totalFlushIntervalMs - before.totalFlushIntervalMs) / pacedFlushes,
+           after.lastFlushIntervalMs);
+  using EventType = gk::HeadlessWebviewBackend::EventType;
+  gk::info("Headless: {} set_html, {} binds, {} calls, {} resolves, {} evals recorded",
+           headless.countOf(EventType::kSetHtml), headless.countOf(EventType::kBind),
+           headless.countOf(EventType::kCall), headless.countOf(EventType::kResolve),
+           headless.countOf(EventType::kEval));
+}
+
+// Widget representation before WidgetStore: an id string and a std::map of attributes per graph vertex.
+struct MapWidget {
+  std::string id;
+  std::map<std::string, std::string> attributes;
+};
+
+// Heap bytes of a std::string / std::map<std::string, std::string> node with libstdc++ (SSO up to 15 chars).
+size_t heapBytes(const std::string &text) {
+  return text.size() > 15 ? text.capacity() + 1 : 0;
+}
+
+// Parent of widget i in a fan-out tree, where widgets are created breadth first and every inner widget has
+// fanOut children.
+gk::WidgetId fanOutParent(const size_t i, const size_t fanOut) {
+  return i == 0 ? gk::kNoWidget : static_cast<gk::WidgetId>((i - 1) / fanOut);
+}
+
+// Builds a fan-out tree of count widgets with ids idPrefix + i into store, and into graph when one is given.
+// typeOf(i, leaf) picks the type of widget i and fill(widget, i, leaf) sets its attributes.
+template<typename TypeOf, typename Fill>
+void buildFanOutTree(gk::WidgetStore &store, gk::HtmlGenerator::WidgetGraphType *graph, const size_t count,
+                     const size_t fanOut, const std::string_view idPrefix, TypeOf &&typeOf, Fill &&fill) {
+  store.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const gk::WidgetId parent = fanOutParent(i, fanOut);
+    const bool leaf = i * fanOut + 1 >= count;
+    const gk::WidgetId widget = store.add(typeOf(i, leaf), std::string(idPrefix) + std::to_string(i), parent);
+    fill(widget, i, leaf);
+    if (graph != nullptr) {
+      graph->add_vertex(store.makeWidget(widget));
+      if (parent != gk::kNoWidget) {
+        graph->add_edge(parent, widget, gk::WidgetEdgeProperties{true});
+      }
+    }
+  }
+}
+
+void benchWidgetStore() {
+  constexpr size_t kWidgets = 100'000;
+  constexpr size_t kFanOut = 10;
+  const std::array<std::string, 5> keys{"class", "style", "data-bind", "title", "aria-label"};
+
+  gk::WidgetStore store;
+  graaf::directed_graph<MapWidget, gk::WidgetEdgeProperties> mapGraph;
+  size_t mapBytes = 0;
+  gk::BenchmarkUtils::run("build 100k widgets, store", 10, [&] {
+    store.clear();
+    buildFanOutTree(store, nullptr, kWidgets, kFanOut, "widget-",
+                    [](size_t, bool) { return gk::Widget::WidgetType::Label; },
+                    [&](const gk::WidgetId widget, const size_t i, bool) {
+                      for (size_t k = 0; k < 2 + i % 4; ++k) {
+                        store.setAttribute(widget, keys[k],
+                                           "value-" + std::to_string(i * 7 + k) + "-of-a-longer-attribute");
+                      }
+                    });
+  });
+  gk::BenchmarkUtils::run("build 100k widgets, graaf + std::map", 10, [&] {
+    mapGraph = {};
+    mapBytes = 0;
+    for (size_t i = 0; i < kWidgets; ++i) {
+      MapWidget widget{"widget-" + std::to_string(i), {}};
+      for (size_t k = 0; k < 2 + i % 4; ++k) {
+        auto [it, inserted] = widget.attributes.emplace(
+          keys[k], "value-" + std::to_string(i * 7 + k) + "-of-a-longer-attribute");
+        mapBytes += 32 + 2 * sizeof(std::string) + heapBytes(it->first) + heapBytes(it->second);
+      }
+      mapBytes += sizeof(MapWidget) + heapBytes(widget.id);
+      const graaf::vertex_id_t vertex = mapGraph.add_vertex(std::move(widget));
+      if (i > 0) {
+        mapGraph.add_edge(fanOutParent(i, kFanOut), vertex, gk::WidgetEdgeProperties{true});
+      }
+    }
+  });
+
+  gk::BenchmarkUtils::run("traverse 100k widgets reading 'title', store", 100, [&] {
+    const gk::AttributeKey title = store.findKey("title");
+    size_t bytes = 0;
+    std::vector<gk::WidgetId> stack{0};
+    while (!stack.empty()) {
+      const gk::WidgetId widget = stack.back();
+      stack.pop_back();
+      bytes += store.getAttribute(widget, title).size();
+      store.forEachChild(widget, [&](const gk::WidgetId child) { stack.push_back(child); });
+    }
+    gk::BenchmarkUtils::doNotOptimize(bytes);
+  });
+  gk::BenchmarkUtils::run("traverse 100k widgets reading 'title', graaf + std::map", 100, [&] {
+    size_t bytes = 0;
+    std::vector<graaf::vertex_id_t> stack{0};
+    while (!stack.empty()) {
+      const graaf::vertex_id_t vertex = stack.back();
+      stack.pop_back();
+      const auto &attributes = mapGraph.get_vertex(vertex).attributes;
+      if (const auto it = attributes.find("title"); it != attributes.end()) {
+        bytes += it->second.size();
+      }
+      for (const graaf::vertex_id_t child: mapGraph.get_neighbors(vertex)) {
+        stack.push_back(child);
+      }
+    }
+    gk::BenchmarkUtils::doNotOptimize(bytes);
+  });
+  gk::info("100k widgets: store {:.1f} MB, std::map widgets about {:.1f} MB before graph overhead",
+           store.getMemoryUsage() / 1048576.0, mapBytes / 1048576.0);
+}
+
+void benchHtmlGenerator() {
+  using WidgetGraph = gk::HtmlGenerator::WidgetGraphType;
+  constexpr size_t kFanOut = 8;
+  const std::array<gk::Widget::WidgetType, 4> types{gk::Widget::WidgetType::Label, gk::Widget::WidgetType::Span,
+                                                    gk::Widget::WidgetType::Paragraph, gk::Widget::WidgetType::Link};
+  const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  gk::ThreadPool pool(maxThreads);
+  const gk::W2UIHtmlGenerator serial;
+  const gk::W2UIHtmlGenerator parallel(&pool);
+
+  for (const size_t widgets: std::array<size_t, 3>{10'000, 100'000, 1'000'000}) {
+    gk::WidgetStore store;
+    WidgetGraph graph;
+    buildFanOutTree(store, &graph, widgets, kFanOut, "w",
+                    [&](const size_t i, const bool leaf) {
+                      return leaf ? types[i % types.size()] : gk::Widget::WidgetType::Layout;
+                    },
+                    [&](const gk::WidgetId widget, const size_t i, const bool leaf) {
+                      store.setAttribute(widget, "class", "row-" + std::to_string(i % 16));
+                      if (leaf) {
+                        store.setAttribute(widget, "text", "Item <" + std::to_string(i) + "> & more");
+                      }
+                    });
+
+    const std::string expected = serial.generateHtml(graph);
+    if (const std::string actual = parallel.generateHtml(graph); actual != expected) {
+      throw std::runtime_error(std::format("Parallel HTML for {} widgets differs from the serial HTML: {} vs {} bytes",
+                                           widgets, actual.size(), expected.size()));
+    }
+    const size_t iterations = std::max<size_t>(1, 1'000'000 / widgets);
+    for (const auto *generator: {&serial, &parallel}) {
+      const std::string mode = generator == &serial ? "serial" : std::format("parallel x{}", maxThreads);
+      const auto result = gk::BenchmarkUtils::run(std::format("html {} widgets, {}", widgets, mode), iterations, [&] {
+        size_t bytes = 0;
+        generator->generate(graph, [&bytes](const std::string_view piece) { bytes += piece.size(); });
+        gk::BenchmarkUtils::doNotOptimize(bytes);
+      });
+      gk::info("html {} widgets, {}: {:.1f}M widgets/s, {:.1f} MB page", widgets, mode,
+               widgets / result.perIterationUs, expected.size() / 1048576.0);
+    }
+  }
+}
+
+void benchLayoutEngine() {
+  constexpr size_t kWidgets = 100'000;
+  constexpr size_t kFanOut = 10;
+  gk::WidgetStore store;
+  gk::LayoutEngine engine(store);
+  buildFanOutTree(store, nullptr, kWidgets, kFanOut, "w",
+                  [](size_t, const bool leaf) {
+                    return leaf ? gk::Widget::WidgetType::Label : gk::Widget::WidgetType::Layout;
+                  },
+                  [&](const gk::WidgetId widget, const size_t i, const bool leaf) {
+                    if (leaf) {
+                      store.setAttribute(widget, "text", "Item " + std::to_string(i));
+                    } else {
+                      const auto direction = i % 2 == 0 ? gk::Widget::LayoutType::Vertical
+                                                        : gk::Widget::LayoutType::Horizontal;
+                      engine.setStyle(widget, {.direction = direction, .padding = 4, .gap = 2});
+                    }
+                  });
+
+  const gk::ScreenSize viewport{1920, 1080};
+  gk::BenchmarkUtils::run("layout 100k widgets, full", 20, [&] {
+    for (gk::WidgetId widget = 0; widget < kWidgets; ++widget) {
+      engine.markDirty(widget);
+    }
+    engine.layout(0, viewport);
+  });
+  gk::info("layout full: {} measured, {} arranged", engine.getMeasuredCount(), engine.getArrangedCount());
+
+  const gk::WidgetId leaf = static_cast<gk::WidgetId>(kWidgets - 1);
+  size_t round = 0;
+  gk::BenchmarkUtils::run("layout 100k widgets, one leaf changed", 10'000, [&] {
+    store.setAttribute(leaf, "text", std::string(1 + round++ % 32, 'x'));
+    engine.markDirty(leaf);
+    engine.layout(0, viewport);
+  });
+  gk::info("layout one leaf: {} measured, {} arranged", engine.getMeasuredCount(), engine.getArrangedCount());
+  const gk::ScreenRect rect = engine.getRect(leaf);
+  gk::info("last leaf at {},{} size {}x{}", rect.position.x, rect.position.y, rect.size.width, rect.size.height);
+}
+
+void benchViewportCulling() {
+  const gk::ScreenSize window{1280, 800};
+  for (const size_t rows: std::array<size_t, 3>{5'000, 50'000, 500'000}) {
+    gk::WidgetStore store;
+    gk::LayoutEngine layout(store);
+    const gk::WidgetId root = store.add(gk::Widget::WidgetType::Layout, "root");
+    for (size_t row = 0; row < rows; ++row) {
+      const gk::WidgetId line = store.add(gk::Widget::WidgetType::Layout, "row-" + std::to_string(row), root);
+      layout.setStyle(line, {.direction = gk::Widget::LayoutType::Horizontal, .gap = 8});
+      for (const std::string_view column: {"key", "value", "description"}) {
+        const gk::WidgetId cell = store.add(gk::Widget::WidgetType::Label, column, line);
+        store.setAttribute(cell, "text", std::string(column) + " " + std::to_string(row));
+      }
+    }
+    layout.layout(root, window);
+    gk::ViewportCuller culler(store, layout, 800);
+    gk::BenchmarkUtils::run(std::format("culling index, {} rows", rows), 10, [&] {
+      culler.rebuild(root);
+    });
+
+    std::string html;
+    size_t emitted = 0;
+    int scroll = 0;
+    gk::BenchmarkUtils::run(std::format("culled emission, {} rows", rows), 1'000, [&] {
+      html.clear();
+      emitted = culler.emit({{0, scroll}, window}, html);
+      scroll = (scroll + 997) % static_cast<int>(rows * 20);
+    });
+    gk::info("{} rows: {} of {} widgets emitted, {} bytes", rows, emitted, store.size(), html.size());
+  }
+}
+
+void benchWidgetSnapshot() {
+  using WidgetGraph = gk::HtmlGenerator::WidgetGraphType;
+  constexpr size_t kWidgets = 100'000;
+  constexpr size_t kFanOut = 10;
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "fluid-widgets.snapshot";
+
+  gk::WidgetStore store;
+  WidgetGraph graph;
+  gk::BenchmarkUtils::run("build 100k widgets from code", 5, [&] {
+    store.clear();
+    graph = {};
+    buildFanOutTree(store, &graph, kWidgets, kFanOut, "widget-",
+                    [](size_t, bool) { return gk::Widget::WidgetType::Label; },
+                    [&](const gk::WidgetId widget, const size_t i, bool) {
+                      store.setAttribute(widget, "class", "row-" + std::to_string(i % 16));
+                      store.setAttribute(widget, "text", "Item " + std::to_string(i));
+                    });
+  });
+  gk::BenchmarkUtils::run("write 100k widget snapshot", 5, [&] {
+    gk::WidgetSnapshot::write(path, store, graph);
+  });
+  gk::WidgetStore restored;
+  WidgetGraph restoredGraph;
+  gk::BenchmarkUtils::run("restore 100k widget snapshot", 5, [&] {
+    if (!gk::WidgetSnapshot::restore(path, restored, restoredGraph)) {
+      gk::error("Failed to restore {}", path.string());
+    }
+  });
+  gk::info("snapshot {:.1f} MB, restored {} widgets, store {:.1f} MB",
+           std::filesystem::file_size(path) / 1048576.0, restored.size(), restored.getMemoryUsage() / 1048576.0);
+  std::filesystem::remove(path);
+}
+
+void benchReactiveExpressions() {
+  using gk::arg;
+  using Fields = gk::StateFields<&PriceState::previous, &PriceState::current, &PriceState::volume,
+                                 &PriceState::trades>;
+  const auto growth = gk::compile<Fields>((arg<1> - arg<0>) / arg<1> * 100);
+  const auto busy = gk::compile<Fields>(arg<3> > 100 && arg<2> >= 1e6);
+  gk::info("growth reads mask {:#x}, busy reads mask {:#x}", growth.kDependencies, busy.kDependencies);
+
+  constexpr size_t kStates = 1'000'000;
+  std::vector<PriceState> states(kStates);
+  for (size_t i = 0; i < kStates; ++i) {
+    states[i] = {100.0 + i % 97, 101.0 + i % 89, 1e4 * (i % 251), static_cast<int>(i % 211)};
+  }
+  double sum = 0;
+  gk::BenchmarkUtils::run("compiled expression, 1M states", 10, [&] {
+    for (const PriceState &state: states) {
+      sum += growth(state);
+    }
+    gk::BenchmarkUtils::doNotOptimize(sum);
+  });
+  gk::BenchmarkUtils::run("hand-written expression, 1M states", 10, [&] {
+    for (const PriceState &state: states) {
+      sum += (state.current - state.previous) / state.current * 100;
+    }
+    gk::BenchmarkUtils::doNotOptimize(sum);
+  });
+
+  // Only the trade count changes, so growth never recomputes.
+  gk::ReactiveState<Fields> state(states.front());
+  gk::Computed growthValue(growth);
+  gk::Computed busyValue(busy);
+  int trades = 0;
+  gk::BenchmarkUtils::run("reactive update, 1M trade count changes", 10, [&] {
+    for (size_t i = 0; i < kStates; ++i) {
+      state.set<&PriceState::trades>(++trades % 211);
+      const uint64_t changed = state.takeChanges();
+      growthValue.update(state.get(), changed);
+      busyValue.update(state.get(), changed);
+    }
+  });
+  gk::info("growth {} evaluations, busy {} evaluations", growthValue.getEvaluationCount(),
+           busyValue.getEvaluationCount());
+}
+
 int main() {
 
   // testEdsl();
   // testFluidUI();
+  // benchSfcParser();
+  // benchComponentRegistry();
+  // benchComponentCache();
+  // benchIncrementalRender();
+  // benchParallelRender();
+  // benchCallbackDispatch();
+  // benchHtmlSerialization();
+  // benchSelectorQueries();
+  // benchHtmlDiff();
+  // benchBatchSerialization();
+  // benchBridgeQueue();
+  // benchBridgeEncoding();
+  // benchHeadlessPipeline();
+  // benchWidgetStore();
+  // benchHtmlGenerator();
+  // benchLayoutEngine();
+  // benchViewportCulling();
+  // benchWidgetSnapshot();
+  // benchReactiveExpressions();
   testJavaScript();
 
   return 0;
 }
 
+struct CounterRequest {
+  long direction;
+};
+
+struct CounterResponse {
+  long count;
+};
+
 int main1() {
   const groklab::ScreenSize screenSize = groklab::getScreenSize();
 
@@ -70,33 +819,44 @@ int main1() {
     buffer << file.rdbuf();
     std::string html = buffer.str();
 
-    webview::webview w(true, nullptr);
-    w.set_title("Bind Example");
-    w.set_size(screenSize.width/2, screenSize.height/2, WEBVIEW_HINT_NONE);
+    gk::NativeWebviewBackend w(true);
+    w.setTitle("Bind Example");
+    w.init(gk::FileUtils::readFileAsString("./web/js/fluid/runtime.js"));
+    w.setSize(screenSize.width/2, screenSize.height/2);
 
-    // A binding that counts up or down and immediately returns the new value.
-    w.bind("count", [&](const std::string &req) -> std::string {
-      // Imagine that req is properly parsed or use your own JSON parser.
-      auto direction = std::stol(req.substr(1, req.size() - 1));
-      return std::to_string(count += direction);
+    // A typed binding that counts up or down and immediately returns the new value; the page calls it through
+    // the generated window.fluid.rpc.count stub.
+    gk::RpcBindings rpc(w);
+    rpc.bind("count", [&](const CounterRequest &request) -> CounterResponse {
+      return {count += request.direction};
     });
 
-    // A binding that creates a new thread and returns the result at a later time.
-    w.bind(
+    // A binding that runs on the async binding pool and returns the result at a later time. The page calls it
+    // through window.fluid.invoke(), which can also cancel it.
+    gk::AsyncBindings bindings(w);
+    bindings.bind(
         "compute",
-        [&](const std::string &id, const std::string &req, void * /*arg*/) {
-          // Create a thread and forget about it for the sake of simplicity.
-          std::thread([&, id, req] {
-            // Simulate load.
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            // Imagine that req is properly parsed or use your own JSON parser.
-            const auto *result = "42";
-            w.resolve(id, 0, result);
-          }).detach();
+        [](const std::string & /*arguments*/, const std::stop_token stop) -> std::string {
+          // Simulate load, giving up early once the call is cancelled.
+          for (int step = 0; step < 10 && !stop.stop_requested(); ++step) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+          }
+          // Imagine that arguments is properly parsed or use your own JSON parser.
+          return "42";
         },
-        nullptr);
+        {.maxConcurrent = 4});
+
+    // A streaming binding: rows are produced on a worker and pulled by the page chunk by chunk.
+    gk::StreamBindings streams(w);
+    streams.bind("report", [](const std::string & /*arguments*/, gk::StreamBindings::Writer &writer) {
+      for (int row = 0; row < 1'000'000; ++row) {
+        if (!writer.writeJson(std::format("[{},\"row {}\",{}]", row, row, row * 0.5))) {
+          return;
+        }
+      }
+    });
 
-    w.set_html(html);
+    w.setHtml(html);
     w.run();
   } catch (const webview::exception &e) {
     gk::critical("Failed to initialize FluidUI with error {}", e.what());
@@ -0,0 +1,443 @@
+// FluidGUI page runtime, injected by FluidUI before any page script runs.
+(function () {
+    if (window.fluid) {
+        return;
+    }
+
+    const stores = new Map();
+    const listeners = new Map();
+    const calls = new Map();
+    let nextCall = 1;
+    // Call and stream tokens start with a prefix unique to this page load, so a call of the previous page that is
+    // still finishing in C++ can never be mistaken for a call of this one.
+    const tokenPrefix = Date.now().toString(36) + Math.random().toString(36).slice(2, 10) + '-';
+
+    function cancelCall(token) {
+        if (window.__fluid_cancel) {
+            window.__fluid_cancel(token);
+        }
+    }
+
+    function cancelStream(token) {
+        if (window.__fluid_stream_cancel) {
+            window.__fluid_stream_cancel(token);
+        }
+    }
+
+    // Calls and streams still running in C++ are useless once the page goes away.
+    window.addEventListener('pagehide', () => {
+        cancelCall('*');
+        cancelStream('*');
+    });
+
+    // With viewport culling the page holds only the widgets of the region named by data-fluid-virtual
+    // ("x,y,width,height"). Once scrolling leaves that region, the widgets of the new one are fetched and patched
+    // into the root element.
+    let viewportPending = false;
+
+    function copyAttribute(element, next, name) {
+        const value = next.getAttribute(name);
+        if (element.getAttribute(name) !== value) {
+            if (value === null) {
+                element.removeAttribute(name);
+            } else {
+                element.setAttribute(name, value);
+            }
+        }
+    }
+
+    // Brings element in line with next, the same widget as freshly emitted by ViewportCuller. Children are
+    // matched by data-fluid-key, so widgets that stay in the region keep their DOM nodes and whatever state the
+    // page holds in them; only spacers and the widgets entering or leaving the region are touched. Both lists
+    // are in widget order, so a single pass suffices.
+    function reconcile(element, next) {
+        copyAttribute(element, next, 'style');
+        copyAttribute(element, next, 'data-fluid-virtual');
+        const isContainer = (node) => Array.from(node.children).some(
+            (child) => child.dataset.fluidKey !== undefined || child.classList.contains('fluid-spacer'));
+        if (!isContainer(next) && !isContainer(element)) {
+            if (element.innerHTML !== next.innerHTML) {
+                element.innerHTML = next.innerHTML;
+            }
+            return;
+        }
+        const existing = new Map();
+        for (const child of element.children) {
+            if (child.dataset.fluidKey !== undefined) {
+                existing.set(child.dataset.fluidKey, child);
+            }
+        }
+        let cursor = element.firstElementChild;
+        for (const child of Array.from(next.children)) {
+            const key = child.dataset.fluidKey;
+            let node = child;
+            if (key !== undefined && existing.has(key)) {
+                node = existing.get(key);
+                existing.delete(key);
+                reconcile(node, child);
+            } else if (key === undefined && cursor && cursor.classList.contains('fluid-spacer')) {
+                node = cursor;
+                copyAttribute(node, child, 'style');
+            }
+            if (node !== cursor) {
+                element.insertBefore(node, cursor);
+            }
+            cursor = node.nextElementSibling;
+        }
+        while (cursor) {
+            const following = cursor.nextElementSibling;
+            cursor.remove();
+            cursor = following;
+        }
+    }
+
+    async function updateViewport() {
+        const root = document.querySelector('[data-fluid-virtual]');
+        if (!root || !window.__fluid_viewport) {
+            return;
+        }
+        const [x, y, width, height] = root.dataset.fluidVirtual.split(',').map(Number);
+        const left = window.scrollX;
+        const top = window.scrollY;
+        if (left >= x && top >= y && left + window.innerWidth <= x + width && top + window.innerHeight <= y + height) {
+            return;
+        }
+        const html = await window.__fluid_viewport(left, top, window.innerWidth, window.innerHeight);
+        if (html === null || !root.isConnected) {
+            return;
+        }
+        const template = document.createElement('template');
+        template.innerHTML = html;
+        if (template.content.firstElementChild) {
+            reconcile(root, template.content.firstElementChild);
+        }
+    }
+
+    window.addEventListener('scroll', () => {
+        if (viewportPending) {
+            return;
+        }
+        viewportPending = true;
+        requestAnimationFrame(() => updateViewport().finally(() => {
+            viewportPending = false;
+        }));
+    }, { passive: true });
+
+    function halfFloat(bits) {
+        const exponent = (bits >> 10) & 0x1f;
+        const mantissa = bits & 0x3ff;
+        const value = exponent === 0 ? mantissa * 2 ** -24
+            : exponent === 31 ? (mantissa ? NaN : Infinity)
+            : (mantissa + 1024) * 2 ** (exponent - 25);
+        return bits & 0x8000 ? -value : value;
+    }
+
+    // Decodes base64 encoded CBOR, as sent by BridgeCodec, into the value the JSON encoding would have produced.
+    function decodeCbor(base64) {
+        const binary = atob(base64);
+        const bytes = new Uint8Array(binary.length);
+        for (let i = 0; i < binary.length; ++i) {
+            bytes[i] = binary.charCodeAt(i);
+        }
+        const view = new DataView(bytes.buffer);
+        const text = new TextDecoder();
+        let offset = 0;
+
+        // Argument of the current item; -1 for indefinite length.
+        function argument(info) {
+            let value;
+            switch (info) {
+                case 24: value = view.getUint8(offset); offset += 1; return value;
+                case 25: value = view.getUint16(offset); offset += 2; return value;
+                case 26: value = view.getUint32(offset); offset += 4; return value;
+                case 27: value = Number(view.getBigUint64(offset)); offset += 8; return value;
+                case 31: return -1;
+                default: return info;
+            }
+        }
+
+        function isBreak() {
+            if (bytes[offset] === 0xff) {
+                offset += 1;
+                return true;
+            }
+            return false;
+        }
+
+        function chunk(major, length) {
+            const slice = bytes.subarray(offset, offset + length);
+            offset += length;
+            return major === 3 ? text.decode(slice) : slice.slice();
+        }
+
+        function item() {
+            const initial = bytes[offset++];
+            const major = initial >> 5;
+            const info = initial & 0x1f;
+            let value;
+            if (major === 7) {
+                switch (info) {
+                    case 20: return false;
+                    case 21: return true;
+                    case 22: return null;
+                    case 23: return undefined;
+                    case 25: value = halfFloat(view.getUint16(offset)); offset += 2; return value;
+                    case 26: value = view.getFloat32(offset); offset += 4; return value;
+                    case 27: value = view.getFloat64(offset); offset += 8; return value;
+                    default: return argument(info);
+                }
+            }
+            const length = argument(info);
+            switch (major) {
+                case 0:
+                    return length;
+                case 1:
+                    return -1 - length;
+                case 2:
+                case 3: {
+                    if (length >= 0) {
+                        return chunk(major, length);
+                    }
+                    const parts = [];
+                    while (!isBreak()) {
+                        parts.push(item());
+                    }
+                    if (major === 3) {
+                        return parts.join('');
+                    }
+                    const joined = new Uint8Array(parts.reduce((total, part) => total + part.length, 0));
+                    let at = 0;
+                    for (const part of parts) {
+                        joined.set(part, at);
+                        at += part.length;
+                    }
+                    return joined;
+                }
+                case 4: {
+                    const array = [];
+                    for (let i = 0; length < 0 ? !isBreak() : i < length; ++i) {
+                        array.push(item());
+                    }
+                    return array;
+                }
+                case 5: {
+                    const object = {};
+                    for (let i = 0; length < 0 ? !isBreak() : i < length; ++i) {
+                        const key = item();
+                        object[key] = item();
+                    }
+                    return object;
+                }
+                default:
+                    // Tags carry no meaning for JSON-shaped values; decode the tagged item.
+                    return item();
+            }
+        }
+
+        return item();
+    }
+
+    function nodeAt(path) {
+        let node = document.documentElement;
+        for (const index of path) {
+            node = node.childNodes[index];
+        }
+        return node;
+    }
+
+    function parseNode(html) {
+        const template = document.createElement('template');
+        template.innerHTML = html;
+        return template.content.firstChild;
+    }
+
+    function makeStore() {
+        const store = { props: {}, state: {} };
+        return window.Vue && window.Vue.reactive ? window.Vue.reactive(store) : store;
+    }
+
+    window.fluid = {
+        // Typed client stubs installed by RpcBindings, one per C++ binding.
+        rpc: {},
+
+        decodeCbor,
+
+        // Reactive { props, state } mirror of the C++ component with the given data-fluid-id.
+        store(id) {
+            let store = stores.get(id);
+            if (!store) {
+                store = makeStore();
+                stores.set(id, store);
+            }
+            return store;
+        },
+
+        // Registers handler(key, value) for messages FluidUI posts on the channel; returns an unsubscribe function.
+        on(channel, handler) {
+            let handlers = listeners.get(channel);
+            if (!handlers) {
+                handlers = new Set();
+                listeners.set(channel, handlers);
+            }
+            handlers.add(handler);
+            return () => handlers.delete(handler);
+        },
+
+        // Delivers one frame worth of bridge messages, packed as [channel, key, value] triples.
+        receive(batch) {
+            for (const [channel, key, value] of batch) {
+                const handlers = listeners.get(channel);
+                if (handlers) {
+                    for (const handler of handlers) {
+                        handler(key, value);
+                    }
+                }
+            }
+        },
+
+        // Calls a binding registered through AsyncBindings. The returned promise settles when the C++ handler
+        // finishes; aborting options.signal cancels the call on the C++ side and rejects the promise.
+        invoke(name, args = [], options = {}) {
+            const token = 'c' + tokenPrefix + (nextCall++);
+            const promise = new Promise((resolve, reject) => calls.set(token, { resolve, reject }));
+            if (options.signal) {
+                options.signal.addEventListener('abort', () => {
+                    const call = calls.get(token);
+                    if (call) {
+                        calls.delete(token);
+                        call.reject(new DOMException('Call cancelled', 'AbortError'));
+                        cancelCall(token);
+                    }
+                }, { once: true });
+            }
+            window[name](token, ...args);
+            return promise;
+        },
+
+        // Opens a binding registered through StreamBindings as an async iterable of chunks (arrays of items):
+        //     for await (const rows of window.fluid.stream('report', [query])) { ... }
+        // The next chunk is only requested once the loop body is done with the last one. Leaving the loop early
+        // cancels the producer.
+        stream(name, args = []) {
+            const token = 's' + tokenPrefix + (nextCall++);
+            let done = false;
+            window[name](token, ...args);
+            return {
+                [Symbol.asyncIterator]() {
+                    return this;
+                },
+                async next() {
+                    if (done) {
+                        return { done: true, value: undefined };
+                    }
+                    try {
+                        const chunk = await window.__fluid_pull(token);
+                        if (chunk === null) {
+                            done = true;
+                            return { done: true, value: undefined };
+                        }
+                        return { done: false, value: chunk };
+                    } catch (error) {
+                        done = true;
+                        throw new Error(error);
+                    }
+                },
+                async return() {
+                    if (!done) {
+                        done = true;
+                        cancelStream(token);
+                    }
+                    return { done: true, value: undefined };
+                }
+            };
+        },
+
+        // Settles a batch of finished calls, packed as [token, status, value] with status 0 resolved,
+        // 1 rejected and 2 cancelled.
+        settle(results) {
+            for (const [token, status, value] of results) {
+                const call = calls.get(token);
+                if (!call) {
+                    continue;
+                }
+                calls.delete(token);
+                if (status === 0) {
+                    call.resolve(value);
+                } else if (status === 2) {
+                    call.reject(new DOMException('Call cancelled', 'AbortError'));
+                } else {
+                    call.reject(new Error(value));
+                }
+            }
+        },
+
+        // Applies one render pass worth of patches produced by RenderPass. Within the component's element (see
+        // Component::appendMarkup), every data-fluid-bind="<name>" element not owned by a nested component shows
+        // the state value or prop of that name; components rendering themselves can listen for fluid:patch.
+        applyPatches(patches) {
+            for (const patch of patches) {
+                const store = this.store(patch.id);
+                Object.assign(store.props, patch.props);
+                Object.assign(store.state, patch.state);
+                const element = document.querySelector('[data-fluid-id="' + patch.id + '"]');
+                if (!element) {
+                    continue;
+                }
+                for (const bound of element.querySelectorAll('[data-fluid-bind]')) {
+                    if (bound.closest('[data-fluid-id]') !== element) {
+                        continue;
+                    }
+                    const name = bound.dataset.fluidBind;
+                    const value = name in store.state ? store.state[name] : store.props[name];
+                    if (value !== undefined) {
+                        const text = typeof value === 'object' ? JSON.stringify(value) : String(value);
+                        if (bound.textContent !== text) {
+                            bound.textContent = text;
+                        }
+                    }
+                }
+                element.dispatchEvent(new CustomEvent('fluid:patch', { detail: patch }));
+            }
+        },
+
+        // Applies the DOM edits produced by HtmlDiff, in order. Child list edits of one parent refer to the
+        // children it had before its first edit, so a snapshot is taken whenever a new parent's edits begin.
+        applyDomPatch(ops) {
+            let parentKey = null;
+            let parent = null;
+            let original = [];
+            let inserted = [];
+            for (const op of ops) {
+                const node = nodeAt(op.path);
+                switch (op.type) {
+                    case 'kSetAttribute':
+                        node.setAttribute(op.name, op.value);
+                        continue;
+                    case 'kRemoveAttribute':
+                        node.removeAttribute(op.name);
+                        continue;
+                    case 'kSetText':
+                        node.nodeValue = op.value;
+                        continue;
+                }
+                const key = op.path.join('/');
+                if (key !== parentKey) {
+                    parentKey = key;
+                    parent = node;
+                    original = Array.from(node.childNodes);
+                    inserted = [];
+                }
+                if (op.type === 'kRemove') {
+                    original[op.from].remove();
+                    continue;
+                }
+                const anchor = op.anchor >= 0 ? original[op.anchor] : op.anchor === -2 ? inserted[op.to + 1] : null;
+                const child = op.type === 'kInsert' ? parseNode(op.value) : original[op.from];
+                if (op.type === 'kInsert') {
+                    inserted[op.to] = child;
+                }
+                parent.insertBefore(child, anchor);
+            }
+        }
+    };
+})();